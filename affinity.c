@@ -0,0 +1,169 @@
+#include "queue.h"
+#include <dirent.h>
+
+// Colocación de las cintas en las CPU (opción -a y atributo "cpus="). Cada cinta recibe tantas CPU
+// consecutivas en el orden de la topología como hilos tiene, de modo que su productor y su consumidor
+// quedan en hilos hermanos del mismo núcleo o en núcleos vecinos del mismo nodo y el intercambio de
+// elementos no sale de la caché compartida. "compact" llena los nodos uno tras otro y "scatter"
+// reparte las cintas entre los nodos. La topología se lee de /sys; el nodo de cada CPU es el enlace
+// nodeN de su directorio y, si no existe, su paquete físico.
+
+// CPU disponible para la fábrica y su posición en la topología
+typedef struct s_cpu
+{
+    int cpu;
+    int node;
+    int package;
+    int core;
+} t_cpu;
+
+// Lee un entero de un fichero de /sys (-1 si no existe)
+static int sysfs_int(int cpu, const char *file)
+{
+    char path[128];
+    FILE *fd;
+    int value;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, file);
+    if (!(fd = fopen(path, "r")))
+        return (-1);
+    if (fscanf(fd, "%d", &value) != 1)
+        value = -1;
+    fclose(fd);
+    return (value);
+}
+
+// Nodo NUMA de una CPU: el enlace nodeN de su directorio en /sys
+static int cpu_node(int cpu)
+{
+    char path[64];
+    struct dirent *entry;
+    DIR *dir;
+    int node;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    if (!(dir = opendir(path)))
+        return (-1);
+    node = -1;
+    while (node < 0 && (entry = readdir(dir)))
+        if (!strncmp(entry->d_name, "node", 4) && isdigit((unsigned char)entry->d_name[4]))
+            node = atoi(entry->d_name + 4);
+    closedir(dir);
+    return (node);
+}
+
+// Orden compacto: nodo, paquete, núcleo y CPU; los hilos hermanos de un núcleo quedan seguidos
+static int compare_cpu(const void *x, const void *y)
+{
+    const t_cpu *a = x;
+    const t_cpu *b = y;
+
+    if (a->node != b->node)
+        return (a->node - b->node);
+    if (a->package != b->package)
+        return (a->package - b->package);
+    if (a->core != b->core)
+        return (a->core - b->core);
+    return (a->cpu - b->cpu);
+}
+
+// CPU que puede usar el proceso, en orden compacto. Devuelve cuántas hay
+static int cpu_topology(t_cpu *cpus)
+{
+    cpu_set_t allowed;
+    int n;
+    int i;
+
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed))
+        return (0);
+    for (i = 0, n = 0; i < CPU_SETSIZE; i++)
+    {
+        if (!CPU_ISSET(i, &allowed))
+            continue ;
+        cpus[n].cpu = i;
+        cpus[n].package = sysfs_int(i, "physical_package_id");
+        cpus[n].core = sysfs_int(i, "core_id");
+        cpus[n].node = cpu_node(i);
+        if (cpus[n].node < 0)
+            cpus[n].node = cpus[n].package;
+        n++;
+    }
+    qsort(cpus, n, sizeof(t_cpu), compare_cpu);
+    return (n);
+}
+
+// Reparte las CPU de las cintas sin lista explícita según la política de la fábrica. Se llama al
+// empezar run_factory, antes de repartir la arena
+void factory_affinity(t_factory *factory)
+{
+    t_cpu *cpus;
+    t_tape *tape;
+    int *cursor; // Siguiente CPU de cada nodo (scatter) o de todas (compact, en cursor[0])
+    int *first; // Primera CPU de cada nodo en el orden compacto
+    int n_cpus;
+    int n_nodes;
+    int node;
+    int count;
+    int i;
+    int j;
+
+    if (factory->affinity == AFFINITY_NONE || factory->pool) // El pool no fija sus trabajadores
+        return ;
+    cpus = safe_malloc(CPU_SETSIZE * sizeof(t_cpu), false);
+    first = safe_malloc((CPU_SETSIZE + 1) * sizeof(int), false);
+    cursor = safe_malloc(CPU_SETSIZE * sizeof(int), true);
+    n_cpus = cpu_topology(cpus);
+    for (i = 0, n_nodes = 0; i < n_cpus; i++) // Los nodos quedan agrupados por el orden compacto
+        if (!i || cpus[i].node != cpus[i - 1].node)
+            first[n_nodes++] = i;
+    first[n_nodes] = n_cpus;
+    for (i = 0; i < factory->n_tapes && n_cpus; i++)
+    {
+        tape = &factory->tapes[i];
+        if (tape->pinned) // Lista explícita del fichero de entrada
+            continue ;
+        node = factory->affinity == AFFINITY_SCATTER ? i % n_nodes : 0;
+        count = factory->affinity == AFFINITY_SCATTER ? first[node + 1] - first[node] : n_cpus;
+        CPU_ZERO(&tape->cpus);
+        for (j = 0; j < (tape->upstream ? 0 : tape->producers) + tape->consumers && j < count; j++)
+            CPU_SET(cpus[first[node] + (cursor[node]++ % count)].cpu, &tape->cpus);
+    }
+    free(cursor);
+    free(first);
+    free(cpus);
+}
+
+// Fija el hilo actual a las CPU de la cinta: slot < 0 para todas (process_manager) o la posición del
+// hilo entre los de la cinta, que recibe una sola CPU
+void affinity_thread(t_tape *queue, int slot)
+{
+    cpu_set_t set;
+    int count;
+    int cpu;
+
+    if (!(count = CPU_COUNT(&queue->cpus)))
+        return ;
+    if (slot < 0)
+    {
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &queue->cpus);
+        return ;
+    }
+    slot %= count;
+    for (cpu = 0; !CPU_ISSET(cpu, &queue->cpus) || slot--; cpu++) // CPU número slot del conjunto
+        ;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+}
+
+// Primer acceso a la parte del buffer de la cinta que se va a usar desde un hilo ya fijado a sus CPU,
+// para que el núcleo reserve esas páginas en su nodo
+void affinity_touch(t_tape *queue)
+{
+    int used;
+
+    if (!CPU_COUNT(&queue->cpus) || !queue->buffer)
+        return ;
+    used = queue->num_elements < queue->max_size ? queue->num_elements : queue->max_size;
+    memset(queue->buffer, 0, queue_buffer_size(queue, used));
+}
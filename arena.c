@@ -0,0 +1,130 @@
+#include "queue.h"
+#include <sys/mman.h>
+
+// Arena de la fábrica. Al empezar run_factory se calcula, a partir de la configuración ya analizada,
+// toda la memoria de la ejecución (buffer de cada cinta, tabla de hilos y lotes locales de sus
+// productores y consumidores si los tiene, muestras de latencia con FACTORY_STATS y nodos de la
+// barrera de arranque) y se reparte de una sola proyección:
+// una llamada al sistema en lugar de varias por cinta, sin cabeceras de malloc entre bloques y, en
+// configuraciones grandes, con páginas enormes que reducen los fallos de TLB. Todo se libera de una
+// vez en free_all. El mismo recorrido sirve para medir (arena sin proyectar) y para repartir.
+
+// Reserva size bytes alineados a align (potencia de dos, como mucho una página). Con la arena sin
+// proyectar solo cuenta el tamaño
+void *arena_alloc(t_arena *arena, size_t size, size_t align)
+{
+    void *ptr;
+
+    arena->used = (arena->used + align - 1) & ~(align - 1);
+    ptr = arena->base ? arena->base + arena->used : NULL;
+    arena->used += size;
+    if (arena->base && arena->used > arena->size) // El cálculo y el reparto no coinciden
+        err_free_exit(NULL, "[ERROR][arena] Arena overflow.");
+    return (ptr);
+}
+
+// Proyecta la arena. Si huge y a partir de ARENA_HUGE_PAGE prueba con páginas enormes reservadas y, si
+// el sistema no tiene, pide al núcleo que use páginas enormes transparentes. Sin reserva de swap: como
+// con calloc, las páginas de una cinta enorme solo ocupan memoria a medida que se usan. Con shared la
+// proyección es compartida con los procesos que se creen después (modo multiproceso)
+static void arena_map(t_arena *arena, size_t size, bool huge, bool shared)
+{
+    int flags;
+
+    flags = (shared ? MAP_SHARED : MAP_PRIVATE) | MAP_ANONYMOUS;
+    arena->huge = false;
+    arena->base = MAP_FAILED;
+    if (huge && size >= ARENA_HUGE_PAGE)
+    {
+        arena->size = (size + ARENA_HUGE_PAGE - 1) & ~(size_t)(ARENA_HUGE_PAGE - 1);
+        arena->base = mmap(NULL, arena->size, PROT_READ | PROT_WRITE,
+            flags | MAP_HUGETLB, -1, 0); // Con reserva: sin ella un fallo sería SIGBUS
+        arena->huge = (arena->base != MAP_FAILED);
+    }
+    if (arena->base == MAP_FAILED)
+    {
+        arena->size = size;
+        arena->base = mmap(NULL, size, PROT_READ | PROT_WRITE, flags | MAP_NORESERVE, -1, 0);
+        if (arena->base == MAP_FAILED)
+            err_free_exit(NULL, "[ERROR][arena] Memory allocation failed.");
+        if (huge && size >= ARENA_HUGE_PAGE)
+            madvise(arena->base, size, MADV_HUGEPAGE);
+    }
+    arena->used = 0;
+}
+
+// Libera la arena de una vez (ningún hilo de la fábrica puede seguir en marcha)
+void arena_destroy(t_arena *arena)
+{
+    if (arena->base)
+        munmap(arena->base, arena->size);
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+}
+
+// Indica si algún hilo de cinta se fija a CPU concretas (opción -a o atributo "cpus=")
+static bool factory_placed(t_factory *factory)
+{
+    int i;
+
+    for (i = 0; i < factory->n_tapes && !factory->pool; i++)
+        if (CPU_COUNT(&factory->tapes[i].cpus))
+            return (true);
+    return (false);
+}
+
+// Recorre la fábrica repartiendo su memoria; sirve tanto para medir como para repartir. Con hilos
+// fijados, cada buffer empieza en su propia página para que su primer acceso lo sitúe en su nodo
+static void factory_layout(t_factory *factory, t_arena *arena, size_t buffer_align)
+{
+    t_tape *tape;
+    int threads;
+    int i;
+
+    for (i = 0; i < factory->n_tapes; i++)
+    {
+        tape = &factory->tapes[i];
+        // En el pool productor y consumidor nunca se ejecutan a la vez: basta la cola circular, sin
+        // tocar el modo de la configuración
+        tape->impl = factory->pool ? QUEUE_MUTEX : tape->mode;
+        tape->buffer = arena_alloc(arena, queue_buffer_size(tape, tape->size_max), buffer_align);
+#ifdef FACTORY_STATS
+        tape->lat_samples = arena_alloc(arena, stats_size(tape), CACHE_LINE); // Muestras de latencia
+#endif
+        tape->threads = NULL;
+        tape->batches = NULL;
+        // Sin hilos propios (pool o cinta en línea): los lotes son de quien ejecuta la cinta
+        if (factory->pool || belt_inline(tape))
+            continue ;
+        threads = (tape->upstream ? 0 : tape->producers) + tape->consumers;
+        tape->threads = arena_alloc(arena, threads * sizeof(pthread_t), CACHE_LINE);
+        tape->batches = arena_alloc(arena, (size_t)threads * belt_batch(tape) * sizeof(t_element), CACHE_LINE);
+    }
+    if (!factory->pool)
+        factory->barrier.nodes = arena_alloc(arena, barrier_size(factory->n_tapes + 1), CACHE_LINE);
+}
+
+// Mide y reparte la memoria de la ejecución. Se llama al empezar run_factory, cuando ya se conocen el
+// tamaño de lote, el modo de ejecución y la colocación; una ejecución anterior deja de ser válida.
+// Si la proyección anterior basta se reutiliza caliente (modo servicio). Con hilos fijados no se usan
+// páginas enormes: una sola página enorme juntaría en un nodo los buffers de cintas de nodos distintos
+void factory_arena(t_factory *factory)
+{
+    t_arena sizing;
+    size_t align;
+    bool placed;
+
+    placed = factory_placed(factory);
+    align = placed ? (size_t)sysconf(_SC_PAGESIZE) : CACHE_LINE;
+    memset(&sizing, 0, sizeof(t_arena));
+    factory_layout(factory, &sizing, align);
+    if (factory->arena.base && sizing.used <= factory->arena.size && !(placed && factory->arena.huge))
+        factory->arena.used = 0;
+    else
+    {
+        arena_destroy(&factory->arena);
+        arena_map(&factory->arena, sizing.used ? sizing.used : CACHE_LINE, !placed, factory->fork_group > 0);
+    }
+    factory_layout(factory, &factory->arena, align);
+}
@@ -0,0 +1,102 @@
+#include "queue.h"
+
+// Barrera reutilizable de árbol combinado. Los participantes se reparten en grupos de BARRIER_FANIN
+// por hoja; el último en llegar a un nodo sube al padre y el resto espera en el nodo, de modo que
+// cada contador solo lo comparten BARRIER_FANIN hilos y el camino hasta la raíz es O(log n).
+// La liberación baja por el mismo árbol: quien ganó un nodo incrementa su generación y despierta a
+// los que esperan en él. Cada nodo ocupa su propia línea de caché y se espera con un futex.
+
+// Nodo del árbol
+struct s_barrier_node
+{
+    _Alignas(CACHE_LINE) atomic_uint gen; // Generación: cambia al liberar el nodo (futex)
+    atomic_int count; // Llegadas que faltan en la ronda actual
+    int fan_in; // Hijos del nodo (participantes u otros nodos)
+    int parent; // Índice del padre (-1 en la raíz)
+};
+
+// Bytes del árbol para participants hilos (los reserva la arena de la fábrica)
+size_t barrier_size(int participants)
+{
+    int children;
+    int n_nodes;
+
+    // Nodos totales: ceil(n / F) hojas, ceil(hojas / F) nodos en el nivel siguiente... hasta la raíz
+    for (n_nodes = 0, children = participants; n_nodes == 0 || children > 1; n_nodes += children)
+        children = (children + BARRIER_FANIN - 1) / BARRIER_FANIN;
+    return (n_nodes * sizeof(t_barrier_node));
+}
+
+// Crea el árbol para participants hilos sobre nodes, de barrier_size(participants) bytes alineados
+// a línea de caché. La memoria sigue siendo del llamador
+void barrier_init(t_barrier *barrier, int participants, void *nodes)
+{
+    int level_start;
+    int level_len;
+    int children;
+    int i;
+
+    barrier->participants = participants;
+    barrier->nodes = nodes;
+    level_start = 0;
+    children = participants;
+    while (true) // Un nivel por vuelta, de las hojas a la raíz
+    {
+        level_len = (children + BARRIER_FANIN - 1) / BARRIER_FANIN;
+        for (i = 0; i < level_len; i++)
+        {
+            t_barrier_node *node = &barrier->nodes[level_start + i];
+
+            node->fan_in = (i == level_len - 1) ? children - i * BARRIER_FANIN : BARRIER_FANIN;
+            node->parent = (level_len == 1) ? -1 : level_start + level_len + i / BARRIER_FANIN;
+            atomic_init(&node->gen, 0);
+            atomic_init(&node->count, node->fan_in);
+        }
+        if (level_len == 1)
+            break;
+        level_start += level_len;
+        children = level_len;
+    }
+}
+
+// Espera a que cambie la generación del nodo: primero espera activa breve y luego el futex
+static void barrier_sleep(t_barrier_node *node, unsigned gen)
+{
+    int spin;
+
+    for (spin = 0; spin < BARRIER_SPIN; spin++)
+    {
+        if (atomic_load_explicit(&node->gen, memory_order_acquire) != gen)
+            return ;
+        cpu_relax();
+    }
+    while (atomic_load_explicit(&node->gen, memory_order_acquire) == gen)
+        futex_wait(&node->gen, gen);
+}
+
+// Llega al nodo; el último sube al padre y, al volver, libera a los que esperaban en el nodo
+static void barrier_arrive(t_barrier *barrier, int index)
+{
+    t_barrier_node *node;
+    unsigned gen;
+
+    node = &barrier->nodes[index];
+    gen = atomic_load_explicit(&node->gen, memory_order_acquire); // No puede cambiar sin esta llegada
+    if (atomic_fetch_sub_explicit(&node->count, 1, memory_order_acq_rel) != 1)
+    {
+        barrier_sleep(node, gen);
+        return ;
+    }
+    atomic_store_explicit(&node->count, node->fan_in, memory_order_relaxed); // Lista para la siguiente ronda
+    if (node->parent >= 0)
+        barrier_arrive(barrier, node->parent);
+    atomic_store_explicit(&node->gen, gen + 1, memory_order_release);
+    if (node->fan_in > 1)
+        futex_wake(&node->gen, INT_MAX);
+}
+
+// Espera a que lleguen todos los participantes. id (0..participants-1) fija la hoja del participante
+void barrier_wait(t_barrier *barrier, int id)
+{
+    barrier_arrive(barrier, id / BARRIER_FANIN);
+}
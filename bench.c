@@ -0,0 +1,229 @@
+#include "queue.h"
+#include <sys/resource.h>
+
+// Banco de pruebas de la fábrica (make bench). Genera configuraciones sintéticas combinando número
+// de cintas, capacidad, elementos por cinta y modo de ejecución, las ejecuta en el propio proceso con
+// run_factory y sin mensajes, y muestra por cada combinación el rendimiento en elementos por segundo,
+// los percentiles 50 y 99 de la latencia put->get por cinta, los cambios de contexto y el pico de RSS.
+// Se compila con FACTORY_STATS y toma las cifras de cada cinta de factory_stats (en JSON incluye
+// también las esperas de productor y consumidor y la ocupación media).
+
+#define BENCH_MAX_VALUES 16 // Valores como máximo en cada lista de parámetros
+
+// Lista de valores de un parámetro ("1,16,256")
+typedef struct s_values
+{
+    int count;
+    int values[BENCH_MAX_VALUES];
+} t_values;
+
+// Parámetros del barrido
+typedef struct s_bench
+{
+    t_values belts;
+    t_values capacities;
+    t_values elements;
+    bool modes[3]; // mutex, spsc, pool
+    int batch_size;
+    int workers;
+    bool json;
+    bool first; // Aún no se ha escrito ningún resultado JSON
+    t_pool *pool;
+} t_bench;
+
+static const char *g_modes[] = {"mutex", "spsc", "pool"};
+
+// Lee una lista de enteros positivos separados por comas
+static bool parse_values(const char *arg, t_values *list)
+{
+    char *end;
+    long value;
+
+    list->count = 0;
+    while (*arg && list->count < BENCH_MAX_VALUES)
+    {
+        value = strtol(arg, &end, 10);
+        if (end == arg || value <= 0 || value > INT_MAX || (*end && *end != ','))
+            return (false);
+        list->values[list->count++] = (int)value;
+        arg = *end ? end + 1 : end;
+    }
+    return (list->count > 0 && !*arg);
+}
+
+// Lee la lista de modos a medir
+static bool parse_modes(const char *arg, bool *modes)
+{
+    size_t len;
+    int i;
+
+    memset(modes, 0, 3 * sizeof(bool));
+    while (*arg)
+    {
+        len = strcspn(arg, ",");
+        for (i = 0; i < 3 && (strlen(g_modes[i]) != len || strncmp(arg, g_modes[i], len)); i++)
+            ;
+        if (i == 3)
+            return (false);
+        modes[i] = true;
+        arg += len + (arg[len] == ',');
+    }
+    return (true);
+}
+
+// Genera la configuración sintética en el formato de entrada de la fábrica
+static char *generate_config(int belts, int capacity, int elements, int mode, size_t *len)
+{
+    char *config;
+    size_t size;
+    size_t off;
+    int i;
+
+    size = 32 + (size_t)belts * 48;
+    config = safe_malloc(size, false);
+    off = snprintf(config, size, "%d\n", belts);
+    for (i = 0; i < belts; i++)
+        off += snprintf(config + off, size - off, "%d %d %d mode=%s\n", i + 1, capacity, elements,
+            mode == 1 ? "spsc" : "mutex");
+    *len = off;
+    return (config);
+}
+
+static int compare_u64(const void *x, const void *y)
+{
+    uint64_t a = *(const uint64_t *)x;
+    uint64_t b = *(const uint64_t *)y;
+
+    return ((a > b) - (a < b));
+}
+
+// Escribe el resultado de una ejecución como fila de tabla u objeto JSON
+static void report(t_bench *bench, t_factory *factory, int mode, int capacity, int elements,
+    uint64_t elapsed, struct rusage *before, struct rusage *after)
+{
+    t_belt_stats *st;
+    uint64_t *p50;
+    uint64_t worst;
+    long ctx;
+    int n;
+    int i;
+
+    st = safe_malloc(factory->n_tapes * sizeof(t_belt_stats), false);
+    p50 = safe_malloc(factory->n_tapes * sizeof(uint64_t), true);
+    for (i = 0, n = 0, worst = 0; i < factory->n_tapes; i++)
+        if (!factory_stats(factory, i, &st[i]) && st[i].p99_ns)
+        {
+            worst = st[i].p99_ns > worst ? st[i].p99_ns : worst;
+            p50[n++] = st[i].p50_ns;
+        }
+    ctx = (after->ru_nvcsw - before->ru_nvcsw) + (after->ru_nivcsw - before->ru_nivcsw);
+    if (bench->json)
+    {
+        printf("%s\n  {\"mode\": \"%s\", \"belts\": %d, \"capacity\": %d, \"elements\": %d, \"batch\": %d, "
+            "\"elements_per_sec\": %.0f, \"context_switches\": %ld, \"max_rss_kb\": %ld, \"per_belt\": [",
+            bench->first ? "" : ",", g_modes[mode], factory->n_tapes, capacity, elements, bench->batch_size,
+            (double)factory->n_tapes * elements / (elapsed / 1e9), ctx, after->ru_maxrss);
+        for (i = 0; i < factory->n_tapes; i++)
+            printf("%s{\"id\": %d, \"p50_ns\": %lu, \"p99_ns\": %lu, \"full_waits\": %lu, \"full_wait_ns\": %lu, "
+                "\"empty_waits\": %lu, \"empty_wait_ns\": %lu, \"occupancy_avg\": %.1f}", i ? ", " : "",
+                st[i].id, (unsigned long)st[i].p50_ns, (unsigned long)st[i].p99_ns,
+                (unsigned long)st[i].full_wait.count, (unsigned long)st[i].full_wait.ns,
+                (unsigned long)st[i].empty_wait.count, (unsigned long)st[i].empty_wait.ns, st[i].occupancy_avg);
+        printf("]}");
+        bench->first = false;
+    }
+    else
+    {
+        qsort(p50, n, sizeof(uint64_t), compare_u64);
+        printf("%-6s %7d %8d %9d %14.0f %12.1f %12.1f %10ld %10ld\n", g_modes[mode], factory->n_tapes,
+            capacity, elements, (double)factory->n_tapes * elements / (elapsed / 1e9),
+            n ? p50[(n - 1) / 2] / 1e3 : 0.0, worst / 1e3, ctx, after->ru_maxrss);
+    }
+    free(p50);
+    free(st);
+}
+
+// Ejecuta una combinación de parámetros y muestra su resultado
+static void bench_run(t_bench *bench, int belts, int capacity, int elements, int mode)
+{
+    t_parse_error err;
+    t_factory *factory;
+    struct rusage before;
+    struct rusage after;
+    uint64_t start;
+    char *config;
+    size_t len;
+
+    config = generate_config(belts, capacity, elements, mode, &len);
+    if (!(factory = parse_buffer(config, len, &err)))
+    {
+        fprintf(stderr, "[ERROR][bench] Generated config is invalid (line %d, column %d: %s).\n", err.line, err.column, err.msg);
+        exit(-1);
+    }
+    free(config);
+    factory->batch_size = bench->batch_size;
+    if (mode == 2)
+    {
+        if (!bench->pool)
+            bench->pool = pool_create(bench->workers);
+        factory->pool = bench->pool;
+    }
+    getrusage(RUSAGE_SELF, &before);
+    start = log_clock();
+    run_factory(factory);
+    start = log_clock() - start;
+    getrusage(RUSAGE_SELF, &after);
+    report(bench, factory, mode, capacity, elements, start, &before, &after);
+    fflush(stdout);
+    free_all(factory);
+}
+
+int main(int argc, char **argv)
+{
+    t_bench bench;
+    int opt;
+    int b;
+    int c;
+    int e;
+    int m;
+
+    memset(&bench, 0, sizeof(t_bench));
+    parse_values("1,16,128", &bench.belts);
+    parse_values("4,64", &bench.capacities);
+    parse_values("20000", &bench.elements);
+    parse_modes("mutex,spsc,pool", bench.modes);
+    bench.batch_size = DEFAULT_BATCH;
+    bench.first = true;
+    while ((opt = getopt(argc, argv, "n:c:e:m:b:w:j")) != -1)
+    {
+        if ((opt == 'n' && parse_values(optarg, &bench.belts))
+            || (opt == 'c' && parse_values(optarg, &bench.capacities))
+            || (opt == 'e' && parse_values(optarg, &bench.elements))
+            || (opt == 'm' && parse_modes(optarg, bench.modes))
+            || (opt == 'b' && (bench.batch_size = atoi(optarg)) > 0)
+            || (opt == 'w' && isdigit(*optarg) && (bench.workers = atoi(optarg)) >= 0)
+            || opt == 'j')
+        {
+            bench.json |= (opt == 'j');
+            continue;
+        }
+        fprintf(stderr, "[ERROR][bench] Usage: %s [-n belts,...] [-c capacities,...] [-e elements,...] "
+            "[-m mutex,spsc,pool] [-b batch_size] [-w workers] [-j]\n", argv[0]);
+        return (-1);
+    }
+    log_init(LOG_QUIET, 1); // Sin mensajes [OK]: solo se mide la fábrica
+    if (bench.json)
+        printf("[");
+    else
+        printf("%-6s %7s %8s %9s %14s %12s %12s %10s %10s\n", "mode", "belts", "capacity", "elements",
+            "elem/s", "p50 (us)", "p99 (us)", "ctx_sw", "rss (KB)");
+    for (m = 0; m < 3; m++)
+        for (b = 0; bench.modes[m] && b < bench.belts.count; b++)
+            for (c = 0; c < bench.capacities.count; c++)
+                for (e = 0; e < bench.elements.count; e++)
+                    bench_run(&bench, bench.belts.values[b], bench.capacities.values[c], bench.elements.values[e], m);
+    if (bench.json)
+        printf("\n]\n");
+    pool_destroy(bench.pool);
+    return (0);
+}
@@ -0,0 +1,146 @@
+#include "queue.h"
+#include <time.h>
+
+// Benchmark de la disposición de t_tape en memoria: ejecuta el mismo intercambio productor/consumidor
+// con mutex y variables de condición sobre un array contiguo de cintas con la disposición original
+// (campos del productor y del consumidor mezclados y cintas vecinas compartiendo líneas de caché) y con
+// la disposición actual (partes separadas y alineadas a CACHE_LINE), para 1, 2, 4... cintas a la vez.
+// Es un programa independiente (make bench_layout). Uso: ./bench_layout [elementos_por_cinta]
+
+#define BENCH_CAPACITY 64 // Capacidad de cada cinta del benchmark
+#define BENCH_ELEMENTS 200000 // Elementos por cinta por defecto
+
+// Reloj monotónico en nanosegundos
+static uint64_t bench_clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+// Disposición original de t_tape
+typedef struct s_packed_tape
+{
+    int id;
+    int max_size;
+    int size;
+    int num_elements;
+    int num_created;
+    int head;
+    int tail;
+    bool finished;
+    pthread_t tape_id;
+    pthread_cond_t not_full;
+    pthread_cond_t not_empty;
+    pthread_mutex_t queue_mtx;
+    t_factory *factory;
+    t_element *elements;
+} t_packed_tape;
+
+// Genera el productor, el consumidor y la ejecución de n cintas para una disposición
+#define BENCH_LAYOUT(T, NAME) \
+static void *NAME##_producer(void *arg) \
+{ \
+    T *queue = arg; \
+    int i; \
+ \
+    for (i = 0; i < queue->num_elements; i++) \
+    { \
+        pthread_mutex_lock(&queue->queue_mtx); \
+        while (queue->size == queue->max_size) \
+            pthread_cond_wait(&queue->not_full, &queue->queue_mtx); \
+        queue->tail = (queue->tail + 1) % queue->max_size; \
+        queue->elements[queue->tail].num_edition = queue->num_created++; \
+        queue->size++; \
+        pthread_cond_signal(&queue->not_empty); \
+        pthread_mutex_unlock(&queue->queue_mtx); \
+    } \
+    return (NULL); \
+} \
+ \
+static void *NAME##_consumer(void *arg) \
+{ \
+    T *queue = arg; \
+    int i; \
+ \
+    for (i = 0; i < queue->num_elements; i++) \
+    { \
+        pthread_mutex_lock(&queue->queue_mtx); \
+        while (queue->size == 0) \
+            pthread_cond_wait(&queue->not_empty, &queue->queue_mtx); \
+        queue->head = (queue->head + 1) % queue->max_size; \
+        queue->size--; \
+        pthread_cond_signal(&queue->not_full); \
+        pthread_mutex_unlock(&queue->queue_mtx); \
+    } \
+    return (NULL); \
+} \
+ \
+static double NAME##_run(int n_tapes, int elements) \
+{ \
+    pthread_t *threads; \
+    T *tapes; \
+    uint64_t start; \
+    int i; \
+ \
+    tapes = aligned_alloc(CACHE_LINE, n_tapes * sizeof(T)); \
+    threads = malloc(2 * n_tapes * sizeof(pthread_t)); \
+    memset(tapes, 0, n_tapes * sizeof(T)); \
+    for (i = 0; i < n_tapes; i++) \
+    { \
+        tapes[i].max_size = BENCH_CAPACITY; \
+        tapes[i].num_elements = elements; \
+        tapes[i].tail = -1; \
+        tapes[i].elements = calloc(BENCH_CAPACITY, sizeof(t_element)); \
+        pthread_mutex_init(&tapes[i].queue_mtx, NULL); \
+        pthread_cond_init(&tapes[i].not_full, NULL); \
+        pthread_cond_init(&tapes[i].not_empty, NULL); \
+    } \
+    start = bench_clock(); \
+    for (i = 0; i < n_tapes; i++) \
+    { \
+        pthread_create(&threads[2 * i], NULL, NAME##_producer, &tapes[i]); \
+        pthread_create(&threads[2 * i + 1], NULL, NAME##_consumer, &tapes[i]); \
+    } \
+    for (i = 0; i < 2 * n_tapes; i++) \
+        pthread_join(threads[i], NULL); \
+    start = bench_clock() - start; \
+    for (i = 0; i < n_tapes; i++) \
+    { \
+        pthread_mutex_destroy(&tapes[i].queue_mtx); \
+        pthread_cond_destroy(&tapes[i].not_full); \
+        pthread_cond_destroy(&tapes[i].not_empty); \
+        free(tapes[i].elements); \
+    } \
+    free(threads); \
+    free(tapes); \
+    return ((double)n_tapes * elements / (start / 1e9)); \
+}
+
+BENCH_LAYOUT(t_packed_tape, packed)
+BENCH_LAYOUT(t_tape, aligned)
+
+int main(int argc, char **argv)
+{
+    double before;
+    double after;
+    long cpus;
+    int elements;
+    int n;
+
+    elements = argc > 1 ? atoi(argv[1]) : BENCH_ELEMENTS;
+    if (elements <= 0)
+        return (fprintf(stderr, "[ERROR][bench_layout] Usage: %s [elements_per_belt]\n", argv[0]), -1);
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    printf("t_tape: %zu bytes before, %zu bytes after; %ld online CPUs; %d elements per belt\n",
+        sizeof(t_packed_tape), sizeof(t_tape), cpus, elements);
+    printf("%8s %16s %16s %8s\n", "belts", "before (elem/s)", "after (elem/s)", "speedup");
+    for (n = 1; n <= 2 * cpus || n <= 4; n *= 2)
+    {
+        before = packed_run(n, elements);
+        after = aligned_run(n, elements);
+        printf("%8d %16.0f %16.0f %7.2fx\n", n, before, after, after / before);
+    }
+    return (0);
+}
@@ -0,0 +1,372 @@
+#include "queue.h"
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+
+// Puntos de control de la fábrica (opciones -c y -r). Un hilo copia cada CHECKPOINT_MS el estado de
+// cada cinta (elementos producidos y los que esperan en la cola) en un fichero binario proyectado
+// con MAP_SHARED: las copias llegan al fichero aunque el proceso muera. Cada cinta tiene dos copias
+// que se escriben por turnos con un número de secuencia impar mientras se escriben, de modo que una
+// copia a medias nunca sustituye a la anterior. Con -r la fábrica se reconstruye del fichero de
+// entrada y cada cinta continúa desde su última copia completa.
+// Una cinta mutex se copia con queue_mtx tomado (su productor solo espera lo que dura la copia) y una
+// SPSC sin bloquear, validando al final qué posiciones no ha liberado el consumidor mientras tanto.
+// Las cintas MPMC (las ediciones se reparten fuera de orden) y las de un pipeline (la cinta siguiente
+// depende de la anterior) no se copian y empiezan de cero al reanudar.
+
+#define CHECKPOINT_MAGIC "FACTCKP1"
+
+// Cabecera del fichero
+typedef struct s_ckpt_header
+{
+    char magic[8];
+    int32_t n_belts;
+    int32_t element_size; // sizeof(t_element) del ejecutable que escribió el fichero
+} t_ckpt_header;
+
+// Copia del estado de una cinta
+typedef struct s_ckpt_copy
+{
+    atomic_uint seq; // Par: copia completa (0: nunca escrita); impar: escribiéndose
+    int32_t capacity; // Capacidad de la cola al copiarla
+    int32_t produced; // Elementos producidos (el siguiente número de edición)
+    int32_t buffered; // Elementos en la cola sin obtener, los últimos producidos
+} t_ckpt_copy;
+
+// Registro de una cinta: su configuración y sus dos copias
+typedef struct s_ckpt_belt
+{
+    int32_t id;
+    int32_t num_elements;
+    int32_t mode;
+    int32_t slots; // Elementos que caben en cada copia (la capacidad máxima de la cinta)
+    uint64_t offset; // Elementos de la primera copia; los de la segunda van a continuación
+    t_ckpt_copy copy[2];
+} t_ckpt_belt;
+
+// Registro de la cinta i del fichero
+static inline t_ckpt_belt *ckpt_belt(t_checkpoint *ckpt, int i)
+{
+    return ((t_ckpt_belt *)(ckpt->base + sizeof(t_ckpt_header)) + i);
+}
+
+// Elementos de la copia c de un registro
+static inline t_element *ckpt_elements(t_checkpoint *ckpt, t_ckpt_belt *belt, int c)
+{
+    return ((t_element *)(ckpt->base + belt->offset) + (size_t)c * belt->slots);
+}
+
+// Indica si el estado de la cinta se puede copiar y restaurar por separado
+static inline bool ckpt_tracked(const t_tape *tape)
+{
+    return (tape->mode != QUEUE_MPMC && !tape->upstream && !tape->next);
+}
+
+// Última copia completa de un registro (NULL si no hay)
+static t_ckpt_copy *ckpt_latest(t_ckpt_belt *belt)
+{
+    unsigned seq0;
+    unsigned seq1;
+
+    seq0 = atomic_load_explicit(&belt->copy[0].seq, memory_order_acquire);
+    seq1 = atomic_load_explicit(&belt->copy[1].seq, memory_order_acquire);
+    seq0 = (seq0 & 1) ? 0 : seq0;
+    seq1 = (seq1 & 1) ? 0 : seq1;
+    if (!seq0 && !seq1)
+        return (NULL);
+    return (&belt->copy[seq1 > seq0]);
+}
+
+// Recorre la fábrica colocando los registros y las copias en el fichero; sin base solo mide
+static size_t ckpt_layout(t_factory *factory, t_checkpoint *ckpt)
+{
+    t_ckpt_belt *belt;
+    size_t offset;
+    int i;
+
+    offset = sizeof(t_ckpt_header) + factory->n_tapes * sizeof(t_ckpt_belt);
+    for (i = 0; i < factory->n_tapes; i++)
+    {
+        offset = (offset + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+        if (ckpt->base)
+        {
+            belt = ckpt_belt(ckpt, i);
+            belt->id = factory->tapes[i].id;
+            belt->num_elements = factory->tapes[i].num_elements;
+            belt->mode = factory->tapes[i].mode;
+            belt->slots = factory->tapes[i].size_max;
+            belt->offset = offset;
+        }
+        offset += 2 * (size_t)factory->tapes[i].size_max * sizeof(t_element);
+    }
+    return (offset);
+}
+
+// Comprueba que el fichero de una reanudación corresponde a la fábrica
+static bool ckpt_matches(t_factory *factory, t_checkpoint *ckpt)
+{
+    t_ckpt_header *header;
+    t_ckpt_belt *belt;
+    t_ckpt_copy *copy;
+    t_tape *tape;
+    int i;
+
+    header = (t_ckpt_header *)ckpt->base;
+    if (memcmp(header->magic, CHECKPOINT_MAGIC, 8) || header->n_belts != factory->n_tapes
+        || header->element_size != (int32_t)sizeof(t_element))
+        return (false);
+    for (i = 0; i < factory->n_tapes; i++)
+    {
+        tape = &factory->tapes[i];
+        belt = ckpt_belt(ckpt, i);
+        if (belt->id != tape->id || belt->num_elements != tape->num_elements
+            || belt->mode != (int32_t)tape->mode || belt->slots != tape->size_max)
+            return (false);
+        if ((copy = ckpt_latest(belt)) && (copy->capacity < tape->size_min || copy->capacity > tape->size_max
+            || copy->buffered < 0 || copy->buffered > copy->capacity || copy->produced > tape->num_elements
+            || copy->buffered > copy->produced))
+            return (false);
+    }
+    return (true);
+}
+
+// Proyecta el fichero de puntos de control. Para reanudar, el fichero debe existir y corresponder a la
+// fábrica; si no, se crea vacío. Se llama tras analizar la entrada, antes de run_factory
+void checkpoint_open(t_factory *factory, const char *path, bool resume)
+{
+    t_checkpoint *ckpt;
+    struct stat st;
+    size_t size;
+    int fd;
+
+    ckpt = &factory->checkpoint;
+    size = ckpt_layout(factory, ckpt);
+    fd = open(path, resume ? O_RDWR : O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1 || fstat(fd, &st) == -1 || (!resume && ftruncate(fd, size) == -1))
+    {
+        if (fd != -1)
+            close(fd);
+        err_free_exit(factory, "[ERROR][checkpoint] Cannot open the checkpoint file.");
+    }
+    if (resume && (size_t)st.st_size != size) // Otra configuración
+    {
+        close(fd);
+        err_free_exit(factory, "[ERROR][checkpoint] The checkpoint file does not match the input file.");
+    }
+    ckpt->base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // La proyección mantiene el fichero
+    if (ckpt->base == MAP_FAILED)
+    {
+        ckpt->base = NULL;
+        err_free_exit(factory, "[ERROR][checkpoint] Cannot open the checkpoint file.");
+    }
+    safe_mutex(&ckpt->mtx, INIT);
+    safe_cond(&ckpt->wake, NULL, INIT);
+    ckpt->size = size;
+    ckpt->resume = resume;
+    if (resume && !ckpt_matches(factory, ckpt))
+        err_free_exit(factory, "[ERROR][checkpoint] The checkpoint file does not match the input file.");
+    if (!resume) // Fichero nuevo (ftruncate lo deja a ceros: ninguna copia escrita)
+    {
+        memcpy(((t_ckpt_header *)ckpt->base)->magic, CHECKPOINT_MAGIC, 8);
+        ((t_ckpt_header *)ckpt->base)->n_belts = factory->n_tapes;
+        ((t_ckpt_header *)ckpt->base)->element_size = sizeof(t_element);
+        ckpt_layout(factory, ckpt);
+    }
+}
+
+// Restaura una cinta desde su última copia. La llama process_manager tras queue_init, antes de que
+// arranquen sus hilos
+void checkpoint_restore(t_tape *queue)
+{
+    t_checkpoint *ckpt;
+    t_ckpt_belt *belt;
+    t_ckpt_copy *copy;
+
+    ckpt = &queue->factory->checkpoint;
+    if (!ckpt->base || !ckpt->resume || !ckpt_tracked(queue))
+        return ;
+    belt = ckpt_belt(ckpt, queue - queue->factory->tapes);
+    if (!(copy = ckpt_latest(belt)))
+        return ;
+    memcpy(queue->buffer, ckpt_elements(ckpt, belt, copy - belt->copy), copy->buffered * sizeof(t_element));
+    queue->num_created = copy->produced;
+    queue->ckpt_base = copy->produced - copy->buffered; // Ediciones ya obtenidas
+    if (queue->mode == QUEUE_SPSC) // Las posiciones del anillo empiezan en la primera sin obtener
+    {
+        atomic_store_explicit(&queue->ring_tail, copy->buffered, memory_order_relaxed);
+        return ;
+    }
+    queue->max_size = copy->capacity; // Capacidad aprendida con "resize="
+    queue_ring(queue);
+    queue->size = copy->buffered;
+    queue->head = 0;
+    queue->tail = copy->buffered - 1;
+}
+
+// Copia una cinta mutex con queue_mtx tomado. Devuelve false si no ha cambiado desde la última copia
+static bool ckpt_mutex(t_tape *queue, t_ckpt_copy *copy, t_element *dst, const t_ckpt_copy *last)
+{
+    t_element *elements;
+    int span;
+
+    safe_mutex(&queue->queue_mtx, LOCK);
+    if (last && last->produced == queue->num_created && last->buffered == queue->size)
+    {
+        safe_mutex(&queue->queue_mtx, UNLOCK);
+        return (false);
+    }
+    elements = queue->buffer;
+    copy->capacity = queue->max_size;
+    copy->produced = queue->num_created;
+    copy->buffered = queue->size;
+    span = queue->max_size - queue->head; // Posiciones hasta el final del buffer
+    if (span > queue->size)
+        span = queue->size;
+    memcpy(dst, &elements[queue->head], span * sizeof(t_element));
+    memcpy(dst + span, elements, (queue->size - span) * sizeof(t_element)); // Parte que da la vuelta
+    safe_mutex(&queue->queue_mtx, UNLOCK);
+    return (true);
+}
+
+// Copia una cinta SPSC sin bloquear a su productor ni a su consumidor: se copian las posiciones entre
+// las dos marcas y después se vuelve a leer la cabeza. Una posición que el consumidor aún no había
+// liberado al releerla no pudo sobrescribirse durante la copia, así que solo se conservan esas. Si
+// el consumidor ha pasado del final copiado se vuelve a intentar (como mucho CHECKPOINT_RETRIES veces).
+// Devuelve false si no ha cambiado desde la última copia o no se ha podido copiar
+static bool ckpt_spsc(t_tape *queue, t_ckpt_copy *copy, t_element *dst, const t_ckpt_copy *last)
+{
+    t_element *elements;
+    unsigned head;
+    unsigned tail;
+    unsigned first;
+    unsigned span;
+    unsigned count;
+    int retries;
+
+    elements = queue->buffer;
+    for (retries = 0; retries < CHECKPOINT_RETRIES; retries++)
+    {
+        tail = atomic_load_explicit(&queue->ring_tail, memory_order_acquire);
+        head = atomic_load_explicit(&queue->ring_head, memory_order_acquire);
+        if (last && last->produced == queue->ckpt_base + (int)tail && last->buffered == (int)(tail - head))
+            return (false);
+        count = tail - head;
+        first = head & queue->mask;
+        span = queue->mask + 1 - first; // Posiciones hasta el final del anillo
+        if (span > count)
+            span = count;
+        memcpy(dst, &elements[first], span * sizeof(t_element));
+        memcpy(dst + span, elements, (count - span) * sizeof(t_element)); // Parte que da la vuelta
+        atomic_thread_fence(memory_order_acquire); // Las lecturas de la copia van antes que la relectura
+        first = atomic_load_explicit(&queue->ring_head, memory_order_relaxed) - head; // Liberadas durante la copia
+        if (first <= count)
+            break ;
+    }
+    if (retries == CHECKPOINT_RETRIES)
+        return (false);
+    memmove(dst, dst + first, (count - first) * sizeof(t_element));
+    copy->capacity = queue->max_size;
+    copy->produced = queue->ckpt_base + tail;
+    copy->buffered = count - first;
+    return (true);
+}
+
+// Toma un punto de control de todas las cintas que han cambiado: cada copia se escribe en la copia
+// más antigua de su registro
+static void checkpoint_take(t_factory *factory)
+{
+    t_checkpoint *ckpt;
+    t_ckpt_belt *belt;
+    t_ckpt_copy *copy;
+    t_ckpt_copy *last;
+    unsigned seq;
+    bool changed;
+    int i;
+
+    ckpt = &factory->checkpoint;
+    for (i = 0; i < factory->n_tapes; i++)
+    {
+        if (!ckpt_tracked(&factory->tapes[i]) || factory->tapes[i].status)
+            continue ;
+        belt = ckpt_belt(ckpt, i);
+        last = ckpt_latest(belt);
+        copy = &belt->copy[last == &belt->copy[0]];
+        seq = (last ? atomic_load_explicit(&last->seq, memory_order_relaxed) : 0) + 1;
+        atomic_store_explicit(&copy->seq, seq, memory_order_relaxed); // Impar: copia a medias
+        atomic_thread_fence(memory_order_release);
+        if (factory->tapes[i].mode == QUEUE_SPSC)
+            changed = ckpt_spsc(&factory->tapes[i], copy, ckpt_elements(ckpt, belt, copy - belt->copy), last);
+        else
+            changed = ckpt_mutex(&factory->tapes[i], copy, ckpt_elements(ckpt, belt, copy - belt->copy), last);
+        // Sin cambios, la copia queda marcada como no escrita y la última sigue siendo la buena
+        atomic_store_explicit(&copy->seq, changed ? seq + 1 : 0, memory_order_release);
+    }
+    msync(ckpt->base, ckpt->size, MS_ASYNC);
+}
+
+// Hilo de los puntos de control: una copia cada CHECKPOINT_MS hasta que termina la fábrica
+static void *checkpoint_loop(void *arg)
+{
+    t_factory *factory;
+    t_checkpoint *ckpt;
+    struct timespec deadline;
+
+    factory = arg;
+    ckpt = &factory->checkpoint;
+    safe_mutex(&ckpt->mtx, LOCK);
+    while (!ckpt->stop)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_nsec += (long)CHECKPOINT_MS * 1000000;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000;
+        deadline.tv_nsec %= 1000000000;
+        while (!ckpt->stop && pthread_cond_timedwait(&ckpt->wake, &ckpt->mtx, &deadline) != ETIMEDOUT)
+            ;
+        if (ckpt->stop)
+            break ;
+        safe_mutex(&ckpt->mtx, UNLOCK);
+        checkpoint_take(factory);
+        safe_mutex(&ckpt->mtx, LOCK);
+    }
+    safe_mutex(&ckpt->mtx, UNLOCK);
+    return (NULL);
+}
+
+// Arranca el hilo de los puntos de control. Se llama cuando todas las cintas están creadas (y
+// restauradas) y antes de que empiecen a producir
+void checkpoint_start(t_factory *factory)
+{
+    if (!factory->checkpoint.base)
+        return ;
+    factory->checkpoint.stop = false;
+    safe_thread(&factory->checkpoint.thread, checkpoint_loop, factory, NULL, CREATE);
+}
+
+// Detiene el hilo y guarda el estado final de las cintas, ya terminadas
+void checkpoint_stop(t_factory *factory)
+{
+    t_checkpoint *ckpt;
+
+    ckpt = &factory->checkpoint;
+    if (!ckpt->base)
+        return ;
+    safe_mutex(&ckpt->mtx, LOCK);
+    ckpt->stop = true;
+    safe_cond(&ckpt->wake, NULL, SIGNAL);
+    safe_mutex(&ckpt->mtx, UNLOCK);
+    safe_thread(&ckpt->thread, NULL, NULL, NULL, JOIN);
+    checkpoint_take(factory);
+    msync(ckpt->base, ckpt->size, MS_SYNC);
+}
+
+// Cierra el fichero de puntos de control (free_all)
+void checkpoint_close(t_checkpoint *ckpt)
+{
+    if (!ckpt->base)
+        return ;
+    munmap(ckpt->base, ckpt->size);
+    ckpt->base = NULL;
+    safe_cond(&ckpt->wake, NULL, DESTROY);
+    safe_mutex(&ckpt->mtx, DESTROY);
+}
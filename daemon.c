@@ -0,0 +1,261 @@
+#include "queue.h"
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Modo servicio (opción -s). El proceso queda escuchando en un socket Unix y cada conexión envía una
+// definición de fábrica con el mismo formato que el fichero de entrada; al cerrar el cliente su lado
+// de escritura, la fábrica se ejecuta y se le responde con el resultado de cada cinta. Los trabajos
+// se ejecutan de uno en uno sobre una única fábrica caliente: el pool, la arena y las cintas ya
+// creadas se conservan entre trabajos. Una cinta con el mismo id que en el trabajo anterior conserva
+// su posición y con ella su sincronización, su buffer en la arena y la capacidad que haya aprendido
+// con "resize=". SIGINT o SIGTERM terminan el servicio al acabar el trabajo en curso: las señales
+// están bloqueadas salvo mientras se espera una conexión en ppoll, así que no se pierde ninguna entre
+// comprobar g_stop y dormir. Un cliente que no escribe ni lee en DAEMON_TIMEOUT_MS pierde su trabajo.
+
+static volatile sig_atomic_t g_stop; // Se ha pedido terminar el servicio
+
+static void daemon_signal(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+// Abre el socket de escucha (sustituye un socket anterior con la misma ruta). Devuelve -1 si falla
+static int daemon_listen(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return (-1);
+    strcpy(addr.sun_path, path);
+    if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+        return (-1);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(fd, DAEMON_BACKLOG) == -1)
+    {
+        close(fd);
+        return (-1);
+    }
+    return (fd);
+}
+
+// Lee la definición completa del cliente, hasta que cierra su lado de escritura. NULL si falla, si
+// supera DAEMON_MAX_JOB bytes o si el cliente pasa DAEMON_TIMEOUT_MS sin escribir (SO_RCVTIMEO)
+static char *daemon_read(int fd, size_t *len)
+{
+    char *buf;
+    char *bigger;
+    size_t cap;
+    ssize_t got;
+
+    cap = 4096;
+    *len = 0;
+    buf = safe_malloc(cap, false);
+    while ((got = read(fd, buf + *len, cap - *len)) != 0)
+    {
+        if (got == -1 && errno == EINTR)
+            continue;
+        if (got == -1 || (*len += got) == DAEMON_MAX_JOB)
+            return (free(buf), NULL);
+        if (*len == cap) // Duplica el buffer
+        {
+            bigger = safe_malloc(cap * 2, false);
+            memcpy(bigger, buf, *len);
+            free(buf);
+            buf = bigger;
+            cap *= 2;
+        }
+    }
+    return (buf);
+}
+
+// Deja sitio en la fábrica caliente para n cintas. Todas las posiciones hasta max_tapes tienen su
+// sincronización creada; si no caben, se crean de nuevo (se pierden las posiciones anteriores)
+static void daemon_reserve(t_factory *warm, int n)
+{
+    int capacity;
+    int i;
+
+    if (n <= warm->max_tapes)
+        return ;
+    capacity = n > 2 * warm->max_tapes ? n : 2 * warm->max_tapes;
+    for (i = 0; i < warm->max_tapes; i++)
+        tape_release(&warm->tapes[i]);
+    free(warm->tapes);
+    warm->tapes = safe_aligned_malloc(capacity * sizeof(t_tape));
+    memset(warm->tapes, 0, capacity * sizeof(t_tape));
+    for (i = 0; i < capacity; i++)
+    {
+        warm->tapes[i].factory = warm;
+        tape_init(&warm->tapes[i]);
+    }
+    warm->max_tapes = capacity;
+    warm->n_tapes = 0;
+}
+
+// Copia en una cinta caliente la configuración de una cinta del trabajo. Si es la misma cinta (mismo
+// id) y su capacidad aprendida sigue dentro de los nuevos límites, la conserva
+static void daemon_tape(t_tape *tape, const t_tape *src, bool same)
+{
+    if (!same || tape->max_size < src->size_min || tape->max_size > src->size_max)
+        tape->max_size = src->max_size;
+    tape->id = src->id;
+    tape->size_min = src->size_min;
+    tape->size_max = src->size_max;
+    tape->wake_low = src->wake_low;
+    tape->wake_high = src->wake_high;
+    tape->wait_us = src->wait_us;
+    tape->num_elements = src->num_elements;
+    tape->mode = src->mode;
+    tape->producers = src->producers;
+    tape->consumers = src->consumers;
+    tape->group = src->group;
+    tape->ordered = src->ordered;
+    tape->priority = src->priority;
+    tape->rate = src->rate;
+    tape->stage = src->stage;
+    tape->cpus = src->cpus;
+    tape->pinned = src->pinned;
+    tape->status = 0;
+}
+
+// Carga el trabajo en la fábrica caliente: cada cinta con el mismo id que una de las n primeras
+// posiciones ocupa esa posición y el resto, las posiciones libres; después se rehacen los pipelines
+static void daemon_load(t_factory *warm, t_factory *job)
+{
+    bool *taken;
+    int *slot;
+    int j;
+    int k;
+
+    daemon_reserve(warm, job->n_tapes);
+    slot = safe_malloc(job->n_tapes * sizeof(int), false);
+    taken = safe_malloc(job->n_tapes * sizeof(bool), true);
+    for (j = 0; j < job->n_tapes; j++)
+    {
+        for (k = 0; k < job->n_tapes && (taken[k] || !warm->tapes[k].max_size
+                || warm->tapes[k].id != job->tapes[j].id); k++)
+            ;
+        slot[j] = k < job->n_tapes ? k : -1;
+        if (slot[j] >= 0)
+            taken[k] = true;
+    }
+    for (j = 0, k = 0; j < job->n_tapes; j++)
+    {
+        if (slot[j] >= 0)
+        {
+            daemon_tape(&warm->tapes[slot[j]], &job->tapes[j], true);
+            continue ;
+        }
+        while (taken[k])
+            k++;
+        taken[k] = true;
+        slot[j] = k;
+        daemon_tape(&warm->tapes[k], &job->tapes[j], false);
+    }
+    for (j = 0; j < job->n_tapes; j++) // Pipelines, con las posiciones de la fábrica caliente
+    {
+        t_tape *tape = &warm->tapes[slot[j]];
+
+        tape->upstream = job->tapes[j].upstream ? &warm->tapes[slot[job->tapes[j].upstream - job->tapes]] : NULL;
+        tape->next = job->tapes[j].next ? &warm->tapes[slot[job->tapes[j].next - job->tapes]] : NULL;
+        atomic_init(&tape->feeders, tape->upstream ? job->tapes[j].upstream->consumers : 0);
+    }
+    warm->n_tapes = job->n_tapes;
+    free(taken);
+    free(slot);
+}
+
+// Atiende una conexión: lee el trabajo, lo ejecuta y responde con el resultado de cada cinta
+static void daemon_job(t_factory *warm, int fd)
+{
+    struct timeval timeout;
+    t_parse_error err;
+    t_factory *job;
+    char *data;
+    size_t len;
+    int i;
+
+    timeout.tv_sec = DAEMON_TIMEOUT_MS / 1000;
+    timeout.tv_usec = DAEMON_TIMEOUT_MS % 1000 * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)); // Un cliente parado no bloquea el servicio
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    if (!(data = daemon_read(fd, &len)))
+    {
+        dprintf(fd, "[ERROR][factory_manager] Invalid job.\n");
+        return ;
+    }
+    job = parse_buffer(data, len, &err);
+    free(data);
+    if (!job)
+    {
+        dprintf(fd, "[ERROR][factory_manager] Invalid file (line %d, column %d: %s).\n", err.line, err.column, err.msg);
+        return ;
+    }
+    daemon_load(warm, job);
+    free_all(job);
+    run_factory(warm);
+    for (i = 0; i < warm->n_tapes; i++)
+    {
+        if (!warm->tapes[i].status)
+            dprintf(fd, "[OK][factory_manager] Process_manager with id %d has finished.\n", warm->tapes[i].id);
+        else
+            dprintf(fd, "[ERROR][factory_manager] Process_manager with id %d has finished with errors.\n", warm->tapes[i].id);
+    }
+    dprintf(fd, "[OK][factory_manager] Finishing.\n");
+}
+
+// Instala las señales del servicio y bloquea SIGINT y SIGTERM. Se llama antes de crear ningún hilo
+// (registro, salida, pool), que heredan el bloqueo: así solo las recibe el bucle del servicio en ppoll
+void daemon_signals(void)
+{
+    struct sigaction sa;
+    sigset_t blocked;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = daemon_signal; // Sin SA_RESTART: ppoll vuelve con EINTR
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN); // Un cliente que se va no termina el servicio
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &blocked, NULL);
+}
+
+// Bucle del servicio sobre la fábrica caliente warm (vacía, con la configuración de ejecución ya
+// puesta y con daemon_signals ya llamada). Devuelve -1 si no puede escuchar en path
+int factory_daemon(t_factory *warm, const char *path)
+{
+    struct pollfd pfd;
+    sigset_t waiting;
+    int listen_fd;
+    int fd;
+
+    if ((listen_fd = daemon_listen(path)) == -1)
+        return (-1);
+    pthread_sigmask(SIG_BLOCK, NULL, &waiting); // Máscara durante la espera: la actual sin SIGINT ni SIGTERM
+    sigdelset(&waiting, SIGINT);
+    sigdelset(&waiting, SIGTERM);
+    pfd.fd = listen_fd;
+    pfd.events = POLLIN;
+    while (!g_stop)
+    {
+        // Solo aquí se atienden las señales: ppoll las desbloquea y espera en un único paso
+        if (ppoll(&pfd, 1, NULL, &waiting) <= 0
+            || (fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC)) == -1)
+            continue;
+        daemon_job(warm, fd);
+        close(fd);
+    }
+    close(listen_fd);
+    unlink(path);
+    warm->n_tapes = warm->max_tapes; // free_all destruye todas las posiciones creadas
+    return (0);
+}
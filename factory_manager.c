@@ -1,4 +1,9 @@
 #include "queue.h"
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+
+static bool g_shared = false; // Sincronización entre procesos (sync_shared)
 
 // Función para imprimir información de la fábrica (comentada)
 // void	print_factory(t_factory *factory)
@@ -13,6 +18,22 @@
 // 	}
 // }
 
+// Crea la sincronización de una cinta
+void tape_init(t_tape *tape)
+{
+    safe_cond(&tape->not_full, NULL, INIT); // Inicializa las condiciones de la cinta
+    safe_cond(&tape->not_empty, NULL, INIT);
+    safe_mutex(&tape->queue_mtx, INIT);
+}
+
+// Destruye la sincronización de una cinta
+void tape_release(t_tape *tape)
+{
+    safe_mutex(&tape->queue_mtx, DESTROY); // Destruye el mutex de la cinta
+    safe_cond(&tape->not_full, NULL, DESTROY); // Destruye la condición de "no llena"
+    safe_cond(&tape->not_empty, NULL, DESTROY); // Destruye la condición de "no vacía"
+}
+
 void	free_all(t_factory *factory)
 {
     if (factory) // Verifica si la fábrica existe
@@ -21,19 +42,15 @@ void	free_all(t_factory *factory)
         {
             // Recorre todas las cintas y destruye sus recursos asociados
             for (int i = 0; i < factory->n_tapes; i++)
-            {
-                safe_mutex(&factory->tapes[i].queue_mtx, DESTROY); // Destruye el mutex de la cinta
-                safe_cond(&factory->tapes[i].not_full, NULL, DESTROY); // Destruye la condición de "no llena"
-                safe_cond(&factory->tapes[i].not_empty, NULL, DESTROY); // Destruye la condición de "no vacía"
-            }
-            free(factory->tapes); // Libera la memoria de las cintas
+                tape_release(&factory->tapes[i]);
+            if (factory->fork_group) // Cintas en memoria compartida (modo multiproceso)
+                munmap(factory->tapes, factory->max_tapes * sizeof(t_tape));
+            else
+                free(factory->tapes); // Libera la memoria de las cintas
         }
-        // Destruye las condiciones y semáforos globales de la fábrica
-        safe_cond(&factory->ready_threads, NULL, DESTROY);
-        safe_cond(&factory->waiting_threads, NULL, DESTROY);
-        safe_cond(&factory->broadcast, NULL, DESTROY);
-        safe_sem(&factory->sem, 0, DESTROY);
-        safe_mutex(&factory->mtx, DESTROY); // Destruye el mutex global de la fábrica
+        arena_destroy(&factory->arena); // Libera de una vez colas, lotes, hilos y barrera
+        checkpoint_close(&factory->checkpoint); // Cierra el fichero de puntos de control
+        metrics_close(&factory->metrics);
         free(factory); // Libera la memoria de la estructura de la fábrica
     }
 }
@@ -42,6 +59,8 @@ void	free_all(t_factory *factory)
 void	err_free_exit(t_factory *factory, const char *msg)
 {
     free_all(factory); // Libera todos los recursos asociados a la fábrica
+    sink_shutdown(); // Escribe la salida pendiente
+    log_shutdown(); // Vuelca los mensajes pendientes antes de salir
     if (msg) // Si hay un mensaje de error, lo imprime
         fprintf(stderr, "%s\n", msg);
     exit(-1); // Sale del programa con un código de error
@@ -64,14 +83,31 @@ void *safe_malloc(size_t size, bool calloc_flag)
     return (ptr); // Retorna el puntero a la memoria asignada
 }
 
+// Función segura para asignar memoria alineada a línea de caché (se libera con free)
+void *safe_aligned_malloc(size_t size)
+{
+    void *ptr;
+
+    if (posix_memalign(&ptr, CACHE_LINE, size))
+        err_free_exit(NULL, "[ERROR] Memory allocation failed.");
+    return (ptr);
+}
+
 // Función segura para manejar operaciones con mutex
 void	safe_mutex(pthread_mutex_t *mutex, t_operations operation)
 {
-    int ret;
+    int ret = -1;
 
     // Realiza la operación correspondiente sobre el mutex
-    if (operation == INIT)
-        ret = pthread_mutex_init(mutex, NULL);
+    if (operation == INIT) // Compartido entre procesos en el modo multiproceso
+    {
+        pthread_mutexattr_t attr;
+
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, g_shared ? PTHREAD_PROCESS_SHARED : PTHREAD_PROCESS_PRIVATE);
+        ret = pthread_mutex_init(mutex, &attr);
+        pthread_mutexattr_destroy(&attr);
+    }
     else if (operation == DESTROY)
         ret = pthread_mutex_destroy(mutex);
     else if (operation == LOCK)
@@ -84,10 +120,18 @@ void	safe_mutex(pthread_mutex_t *mutex, t_operations operation)
         err_free_exit(NULL, "[ERROR][factory_manager] Mutex operation failed.");
 }
 
+// A partir de aquí los mutex, las condiciones y los futex que se creen o usen sirven entre procesos
+// (modo multiproceso: la memoria de las cintas es compartida y las esperas de un proceso las
+// despierta otro). Se llama antes de crear la sincronización de las cintas
+void sync_shared(void)
+{
+    g_shared = true;
+}
+
 // Función segura para manejar operaciones con semáforos
 void safe_sem(sem_t *sem, int value, t_operations operation)
 {
-    int ret;
+    int ret = -1;
 
     // Realiza la operación correspondiente sobre el semáforo
     if (operation == INIT)
@@ -107,7 +151,7 @@ void safe_sem(sem_t *sem, int value, t_operations operation)
 // Función segura para manejar operaciones con hilos
 void safe_thread(pthread_t *thread, void *(*f)(void *), void *arg, void **retval, t_operations operation)
 {
-    int ret;
+    int ret = -1;
 
     // Realiza la operación correspondiente sobre el hilo
     if (operation == CREATE)
@@ -125,11 +169,19 @@ void safe_thread(pthread_t *thread, void *(*f)(void *), void *arg, void **retval
 // Función segura para manejar operaciones con variables de condición
 void safe_cond(pthread_cond_t *cond, pthread_mutex_t *mutex, t_operations operation)
 {
-    int ret;
+    int ret = -1;
 
     // Realiza la operación correspondiente sobre la variable de condición
-    if (operation == INIT)
-        ret = pthread_cond_init(cond, NULL);
+    if (operation == INIT) // Con reloj monótono para las esperas con plazo ("timeout=")
+    {
+        pthread_condattr_t attr;
+
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_condattr_setpshared(&attr, g_shared ? PTHREAD_PROCESS_SHARED : PTHREAD_PROCESS_PRIVATE);
+        ret = pthread_cond_init(cond, &attr);
+        pthread_condattr_destroy(&attr);
+    }
     else if (operation == DESTROY)
         ret = pthread_cond_destroy(cond);
     else if (operation == SIGNAL)
@@ -144,185 +196,305 @@ void safe_cond(pthread_cond_t *cond, pthread_mutex_t *mutex, t_operations operat
         err_free_exit(NULL, "[ERROR][factory_manager] Condition variable operation failed.");
 }
 
+// Duerme en el futex mientras *addr siga valiendo value (las señales y despertares espurios
+// se resuelven en el bucle del llamante, que vuelve a comprobar su condición)
+void futex_wait(atomic_uint *addr, unsigned value)
+{
+    syscall(SYS_futex, (uint32_t *)addr, g_shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+// Como futex_wait, pero despierta como mucho ns nanosegundos después
+void futex_timedwait(atomic_uint *addr, unsigned value, uint64_t ns)
+{
+    struct timespec timeout;
+
+    timeout.tv_sec = ns / 1000000000ull;
+    timeout.tv_nsec = ns % 1000000000ull;
+    syscall(SYS_futex, (uint32_t *)addr, g_shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, value, &timeout, NULL, 0);
+}
+
+// Despierta hasta count hilos dormidos en el futex
+void futex_wake(atomic_uint *addr, int count)
+{
+    syscall(SYS_futex, (uint32_t *)addr, g_shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
 // Función segura para cerrar un archivo
 void safe_close(FILE *fd)
 {
-    int ret;
+    int ret = -1;
 
     ret = fclose(fd); // Cierra el archivo
     if (ret == EOF) // Si ocurre un error al cerrar, libera recursos y sale con error
         err_free_exit(NULL, "[ERROR][factory_manager] Error in fclose.");
 }
 
-// Función para verificar si el archivo de entrada tiene el formato correcto
-static bool check_input(FILE *fd)
+// Sincroniza la fábrica con las cintas en las dos fases del arranque: todas las cintas creadas antes de
+// que ninguna anuncie que espera, y todas esperando antes de que ninguna empiece a producir
+static void synchro(t_factory *factory)
 {
-    int count = 0;
-    int max_tapes = 0;
-    char *line;
-    char *ptr;
+    barrier_wait(&factory->barrier, factory->barrier.participants - 1); // Todas las cintas están listas
+    barrier_wait(&factory->barrier, factory->barrier.participants - 1); // Todas las cintas están esperando: arrancan
+}
 
-    line = safe_malloc((size_t)1024, false); // Asigna memoria para leer una línea
-    if (!fgets(line, 1024, fd)) // Lee la primera línea del archivo
-    {
-        free(line); // Libera memoria si fgets falla
-        return (false);
-    }
-    ptr = line;
+// Ejecuta la fábrica en el pool de hilos: las cintas son tareas y no hay hilos propios por cinta,
+// pero se conservan los mensajes y el informe de estado de cada cinta
+static void run_factory_pool(t_factory *factory)
+{
+    t_tape *tape;
+    int i;
 
-    // Contar la cantidad de números en la línea
-    while (*ptr)
+    for (i = 0; i < factory->n_tapes; i++)
+        log_msg(LOG_TAPE_CREATED, factory->tapes[i].id, 0);
+    for (i = 0; i < factory->n_tapes; i++)
     {
-        // Saltar espacios
-        while (isspace(*ptr))
-            ptr++;
-
-        // Verificar si hay un número
-        if (isdigit(*ptr))
+        tape = &factory->tapes[i];
+        tape->elements = NULL; // Sin crear: la crea el primer turno de belt_step (también al repetirse)
+        tape->num_created = 0; // Las métricas leen la cinta antes de su primer turno
+        tape->size = 0;
+        if (tape->num_elements <= 0 || tape->max_size <= 0)
         {
-            count++;
-            // Avanzar hasta el final del número
-            while (isdigit(*ptr))
-                ptr++;
-        }
-        if (count == 1)
-            max_tapes = count; // El primer número es el número máximo de cintas
-        else if (*ptr != '\0' && !isspace(*ptr))
-        {
-            free(line); // Libera memoria si hay un carácter no válido
-            return (false);
+            tape->status = -1;
+            fprintf(stderr, "[ERROR][process_manager] Arguments not valid.\n");
         }
+        else
+            log_msg(LOG_TAPE_WAITING, tape->id, tape->num_elements);
     }
-    free(line); // Libera la memoria de la línea
-    fseek(fd, 0, SEEK_SET); // Mueve el puntero del archivo al inicio
-
-    // Verifica que la cantidad de números cumpla con el formato esperado
-    if ((count - max_tapes) % 3 != 0)
-        return (false);
-    return (true);
+    metrics_start(factory);
+    pool_run(factory->pool, factory); // Todas las cintas arrancan a la vez al repartirse entre los trabajadores
+    metrics_stop(factory);
+    for (i = 0; i < factory->n_tapes; i++)
+    {
+        if (!factory->tapes[i].status)
+            log_msg(LOG_TAPE_FINISHED, factory->tapes[i].id, 0);
+        else
+            fprintf(stderr, "[ERROR][factory_manager] Process_manager with id %d has finished with errors.\n", factory->tapes[i].id);
+    }
+    log_msg(LOG_FINISHING, 0, 0);
 }
 
-// Función para analizar el archivo de entrada y crear la fábrica
-static t_factory	*parser(const char *filename)
+// Reparte las cintas pequeñas (belt_inline) entre hilos que las ejecutan en línea, al menos
+// INLINE_BELTS por hilo y no más hilos que núcleos, y numera los participantes de la barrera: las
+// cintas con process_manager, después un participante por hilo en línea. Devuelve los hilos
+static t_inline_run *inline_plan(t_factory *factory, t_tape **small, int *n_runs, int *participants)
 {
-    FILE *fd;
-    t_tape temp;
-    t_factory *factory;
+    t_inline_run *runs;
+    long cpus;
+    int n_small;
+    int per_run;
+    int i;
 
-    if (!(fd = fopen(filename, "r"))) // Abre el archivo
-    {
-        err_free_exit(NULL, "[ERROR][factory_manager] Invalid file.");
-    }
-    if (!check_input(fd)) // Verifica el formato del archivo
+    *participants = 0;
+    for (i = 0, n_small = 0; i < factory->n_tapes; i++)
     {
-        safe_close(fd);
-        err_free_exit(NULL, "[ERROR][factory_manager] Invalid file.");
+        if (belt_inline(&factory->tapes[i]))
+            small[n_small++] = &factory->tapes[i];
+        else
+            factory->tapes[i].barrier_id = (*participants)++;
     }
-    factory = safe_malloc(sizeof(t_factory), false); // Asigna memoria para la fábrica
-    if (fscanf(fd, "%d", &factory->max_tapes) != 1 || factory->max_tapes <= 0) // Lee el número máximo de cintas
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    *n_runs = (n_small + INLINE_BELTS - 1) / INLINE_BELTS;
+    if (cpus > 0 && *n_runs > cpus)
+        *n_runs = cpus;
+    per_run = *n_runs ? (n_small + *n_runs - 1) / *n_runs : 0;
+    *n_runs = per_run ? (n_small + per_run - 1) / per_run : 0; // Ningún hilo sin cintas
+    runs = safe_malloc((*n_runs ? *n_runs : 1) * sizeof(t_inline_run), false);
+    for (i = 0; i < *n_runs; i++)
     {
-        safe_close(fd);
-        err_free_exit(factory, "[ERROR][factory_manager] Invalid file.");
+        runs[i].tapes = small + i * per_run;
+        runs[i].n_tapes = n_small - i * per_run < per_run ? n_small - i * per_run : per_run;
+        runs[i].barrier_id = (*participants)++;
     }
-    
-    factory->tapes = safe_malloc(factory->max_tapes * sizeof(t_tape), false); // Asigna memoria para las cintas
-    factory->n_tapes = 0;
-    factory->ready_tapes = 0;
-    factory->waiting_tapes = 0;
-    safe_cond(&factory->ready_threads, NULL, INIT); // Inicializa las variables de condición
-    safe_cond(&factory->waiting_threads, NULL, INIT);
-    safe_cond(&factory->broadcast, NULL, INIT);
-    safe_sem(&factory->sem, 0, INIT); // Inicializa el semáforo
-    safe_mutex(&factory->mtx, INIT); // Inicializa el mutex
-
-    // Lee la información de las cintas del archivo y guarda dicha información en una variable temporal
-	// Verifica que el formato sea correcto y que los valores sean válidos
-    while (fscanf(fd, "%d %d %d", &temp.id, &temp.max_size, &temp.num_elements) == 3)
-    {
-        if (temp.max_size <= 0 || temp.num_elements <= 0)
-        {
-            safe_close(fd);
-            err_free_exit(factory, "[ERROR][factory_manager] Invalid file.");
-        }
-        if (factory->n_tapes >= factory->max_tapes)
-        {
-            safe_close(fd);
-            err_free_exit(factory, "[ERROR][factory_manager] Invalid file.");
-        }
-        temp.factory = factory;
-        temp.finished = false;
-        temp.num_created = 0;
-        safe_cond(&temp.not_full, NULL, INIT); // Inicializa las condiciones de la cinta
-        safe_cond(&temp.not_empty, NULL, INIT);
-        safe_mutex(&temp.queue_mtx, INIT);
-        factory->tapes[factory->n_tapes++] = temp; // Agrega la cinta a la fábrica
-    }
-    
-    safe_close(fd); // Cierra el archivo
-    return (factory); // Retorna la fábrica creada
+    return (runs);
 }
 
-// Se encarga de sincronizar los procesos en dos barreras:
-// La primera espera a que todos los procesos estén listos y la segunda espera a que todos los procesos estén esperando
-// La primera barrera se implementa con un semáforo y una condición, mientras que la segunda barrera se implementa con doble condición y broadcast
-static void synchro(t_factory *factory)
-{
-    safe_mutex(&factory->mtx, LOCK);
-    while (factory->ready_tapes < factory->n_tapes)
-        safe_cond(&factory->ready_threads, &factory->mtx, WAIT); // Espera a que todos los procesos estén listos
-    safe_mutex(&factory->mtx, UNLOCK);
-
-    for (int i = 0; i < factory->n_tapes; ++i)
-        safe_sem(&factory->sem, 0, POST); // Desbloquea todos los procesos
-
-    safe_mutex(&factory->mtx, LOCK);
-    while (factory->waiting_tapes < factory->n_tapes)
-        safe_cond(&factory->waiting_threads, &factory->mtx, WAIT); // Espera a que todos los procesos estén esperando
-    safe_cond(&factory->broadcast, NULL, BROADCAST); // Desbloquea todos los procesos
-    safe_mutex(&factory->mtx, UNLOCK);
-}
-
-// Función principal para ejecutar la fábrica
-static void	run_factory(t_factory *factory)
+// Ejecuta la fábrica con un hilo process_manager por cinta, salvo las cintas pequeñas, que se
+// ejecutan en línea por grupos en unos pocos hilos (crear y unir tres hilos costaría más que su trabajo)
+static void run_factory_threads(t_factory *factory)
 {
+    t_inline_run *runs;
+    t_tape **small;
+    int participants;
+    int n_runs;
     int i;
     int *status;
 
-    // Crea un hilo para cada cinta
+    small = safe_malloc((factory->n_tapes ? factory->n_tapes : 1) * sizeof(t_tape *), false);
+    runs = inline_plan(factory, small, &n_runs, &participants);
+    // Participantes más la propia fábrica; los nodos están en la arena
+    barrier_init(&factory->barrier, participants + 1, factory->barrier.nodes);
+
+    // Crea un hilo para cada cinta que no se ejecuta en línea
     for (i = 0; i < factory->n_tapes; i++)
     {
-        safe_thread(&factory->tapes[i].tape_id, process_manager, &factory->tapes[i], NULL, CREATE);
-        printf("[OK][factory_manager] Process_manager with id %d has been created.\n", factory->tapes[i].id);
+        if (!belt_inline(&factory->tapes[i]))
+            safe_thread(&factory->tapes[i].tape_id, process_manager, &factory->tapes[i], NULL, CREATE);
+        log_msg(LOG_TAPE_CREATED, factory->tapes[i].id, 0);
     }
+    for (i = 0; i < n_runs; i++)
+        safe_thread(&runs[i].thread, inline_runner, &runs[i], NULL, CREATE);
 
     synchro(factory); // Sincroniza los procesos
+    checkpoint_start(factory); // Las cintas ya están creadas y restauradas
+    metrics_start(factory);
 
     // Espera a que todos los hilos terminen
+    for (i = 0; i < n_runs; i++)
+        safe_thread(&runs[i].thread, NULL, NULL, NULL, JOIN);
     for (i = 0; i < factory->n_tapes; i++)
     {
-        safe_thread(&factory->tapes[i].tape_id, NULL, NULL, (void **)&status, JOIN); // Une los hilos
+        status = &factory->tapes[i].status; // Resultado de una cinta en línea
+        if (!belt_inline(&factory->tapes[i]))
+            safe_thread(&factory->tapes[i].tape_id, NULL, NULL, (void **)&status, JOIN); // Une los hilos
         if (!*status)
-            printf("[OK][factory_manager] Process_manager with id %d has finished.\n", factory->tapes[i].id);
+            log_msg(LOG_TAPE_FINISHED, factory->tapes[i].id, 0);
         else
             fprintf(stderr, "[ERROR][factory_manager] Process_manager with id %d has finished with errors.\n", factory->tapes[i].id);
-        free(status); // Libera el estado del hilo
     }
-    printf("[OK][factory_manager] Finishing.\n");
+    checkpoint_stop(factory); // Estado final de las cintas
+    metrics_stop(factory); // Muestra final
+    log_msg(LOG_FINISHING, 0, 0);
+    free(runs);
+    free(small);
+}
+
+// Función principal para ejecutar la fábrica
+void	run_factory(t_factory *factory)
+{
+    factory_affinity(factory); // CPU de cada cinta según la política (-a)
+    factory_priority(factory); // Prioridad de referencia para el valor nice de cada hilo
+    factory_arena(factory); // Toda la memoria de la ejecución en una sola proyección
+    if (factory->pool)
+        run_factory_pool(factory);
+    else if (factory->fork_group)
+        run_factory_fork(factory); // Un proceso por cada grupo de cintas
+    else
+        run_factory_threads(factory);
+    factory_rates(factory, stderr); // Ritmo conseguido por cada cinta (solo con "priority=" o "rate=")
+#ifdef FACTORY_STATS
+    if (factory->stats_out)
+        factory_stats_dump(factory, factory->stats_out); // Informe por cinta al terminar
+#endif
+}
+
+#ifndef FACTORY_BENCH // El benchmark (make bench) aporta su propio main y llama a run_factory
+
+// Muestra el uso del programa y termina con error
+static int usage(const char *name)
+{
+    fprintf(stderr, "[ERROR][factory_manager] Usage: %s [-b batch_size] [-v level] [-S sample] [-p] [-w workers] [-a compact|scatter] [-f belts_per_process] [-c checkpoint [-r]] [-m metrics [-M interval_ms]] [-o output | -O output_dir] <input_file | -s socket>\n", name);
+    return (-1);
 }
 
 // Función principal del programa
-int main (int argc, const char **argv)
+int main (int argc, char **argv)
 {
     t_factory *factory;
-
-    // Verifica que se pase el archivo de entrada como argumento
-    if (argc != 2)
+    int batch_size;
+    int level;
+    int sample;
+    int workers;
+    t_affinity affinity;
+    const char *socket_path;
+    const char *checkpoint_path;
+    const char *metrics_path;
+    const char *sink_path;
+    bool sink_per_belt;
+    int metrics_ms;
+    bool resume;
+    int fork_group;
+    int opt;
+
+    batch_size = DEFAULT_BATCH;
+    level = LOG_ELEMENTS;
+    sample = 1;
+    workers = -1;
+    affinity = AFFINITY_NONE;
+    socket_path = NULL;
+    checkpoint_path = NULL;
+    metrics_path = NULL;
+    sink_path = NULL;
+    sink_per_belt = false;
+    metrics_ms = 0;
+    resume = false;
+    fork_group = 0;
+    while ((opt = getopt(argc, argv, "b:v:S:pw:a:s:c:rf:m:M:o:O:")) != -1) // Opciones de ejecución
     {
-        fprintf(stderr, "[ERROR][factory_manager] Usage: %s <input_file>\n", argv[0]);
-        return (-1);
+        if (opt == 'f' && (fork_group = atoi(optarg)) > 0)
+            continue;
+        if ((opt == 'o' || opt == 'O') && *optarg && !sink_path)
+        {
+            sink_path = optarg; // Salida binaria: un fichero (-o) o uno por cinta en un directorio (-O)
+            sink_per_belt = (opt == 'O');
+            continue;
+        }
+        if ((opt == 'm' && *optarg && (metrics_path = optarg)) || (opt == 'M' && (metrics_ms = atoi(optarg)) > 0))
+            continue;
+        if ((opt == 'c' && *optarg && (checkpoint_path = optarg)) || (opt == 'r' && (resume = true)))
+            continue;
+        if (opt == 's' && *optarg)
+        {
+            socket_path = optarg; // Modo servicio: los trabajos llegan por el socket
+            continue;
+        }
+        if (opt == 'a' && (!strcmp(optarg, "compact") || !strcmp(optarg, "scatter")))
+        {
+            affinity = !strcmp(optarg, "compact") ? AFFINITY_COMPACT : AFFINITY_SCATTER;
+            continue;
+        }
+        if (opt == 'b' && (batch_size = atoi(optarg)) > 0)
+            continue;
+        if (opt == 'v' && isdigit(*optarg) && (level = atoi(optarg)) <= LOG_ELEMENTS)
+            continue;
+        if (opt == 'S' && (sample = atoi(optarg)) > 0)
+            continue;
+        if (opt == 'p' && workers < 0)
+            workers = 0; // Tantos trabajadores como núcleos
+        if (opt == 'p' || (opt == 'w' && isdigit(*optarg) && (workers = atoi(optarg)) >= 0))
+            continue;
+        return (usage(argv[0]));
     }
-    factory = parser(argv[1]); // Analiza el archivo de entrada y crea la fábrica
-    run_factory(factory); // Ejecuta la fábrica
+    // Verifica que se pase el archivo de entrada como argumento (o el socket del modo servicio)
+    if (argc - optind != (socket_path ? 0 : 1))
+        return (usage(argv[0]));
+    // Los puntos de control son de una ejecución con hilos por cinta a partir de un fichero
+    if ((resume && !checkpoint_path) || (checkpoint_path && (socket_path || workers >= 0)))
+        return (usage(argv[0]));
+    if (fork_group && (socket_path || workers >= 0)) // El modo multiproceso es el de hilos por cinta
+        return (usage(argv[0]));
+    if (metrics_ms && !metrics_path) // El intervalo es de las métricas
+        return (usage(argv[0]));
+    if (socket_path)
+        factory = factory_create(0); // Fábrica caliente, las cintas llegan con cada trabajo
+    else
+        factory = parser(argv[optind]); // Analiza el archivo de entrada y crea la fábrica
+    if (fork_group)
+        factory_share(factory, fork_group); // Cintas en memoria compartida entre los procesos
+    if (checkpoint_path)
+        checkpoint_open(factory, checkpoint_path, resume); // Con -r, las cintas continúan donde se quedaron
+    if (metrics_path)
+        metrics_open(factory, metrics_path, metrics_ms ? metrics_ms : METRICS_MS); // Muestras de las cintas en marcha
+    factory->batch_size = batch_size;
+    factory->affinity = affinity;
+    if (socket_path)
+        daemon_signals(); // Antes de crear hilos: las señales solo se atienden esperando conexiones
+    log_init(level, sample); // Arranca el hilo escritor del registro
+    if (sink_path && sink_init(sink_path, sink_per_belt) == -1)
+        err_free_exit(factory, "[ERROR][sink] Cannot create the output file.");
+    if (workers >= 0)
+        factory->pool = pool_create(workers); // Pool de tamaño fijo en lugar de tres hilos por cinta
+#ifdef FACTORY_STATS
+    factory->stats_out = stderr; // make stats: informe de cada cinta al terminar
+#endif
+    if (!socket_path)
+        run_factory(factory); // Ejecuta la fábrica
+    else if (factory_daemon(factory, socket_path) == -1)
+        fprintf(stderr, "[ERROR][factory_manager] Cannot listen on socket %s.\n", socket_path);
+    pool_destroy(factory->pool);
+    sink_shutdown(); // Escribe la salida pendiente
+    log_shutdown(); // Vuelca los mensajes pendientes
     free_all(factory); // Libera todos los recursos
     return (EXIT_SUCCESS);
 }
+
+#endif
@@ -0,0 +1,138 @@
+#include "queue.h"
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+// Modo multiproceso (opción -f N). Cada grupo de N cintas consecutivas se ejecuta en su propio proceso,
+// de modo que el fallo de una cinta (una señal, un abort) solo termina las de su grupo. Las cintas y
+// la arena (colas, lotes y barrera de arranque) están en memoria compartida creada antes de fork, así
+// que los elementos siguen pasando de un proceso a otro sin copias; los mutex y las condiciones se
+// crean compartidos entre procesos y los futex dejan de ser privados. El proceso principal participa
+// en la barrera como la fábrica y recoge el resultado de cada grupo con waitpid. Un pipeline repartido
+// entre grupos no queda aislado: si muere el grupo de una cinta, la siguiente espera sus elementos.
+
+// Lleva las cintas a memoria compartida y su sincronización a mutex y condiciones entre procesos. Se
+// llama tras analizar la entrada, antes de run_factory
+void factory_share(t_factory *factory, int group)
+{
+    t_tape *tapes;
+    size_t size;
+    int i;
+
+    size = factory->max_tapes * sizeof(t_tape);
+    tapes = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (tapes == MAP_FAILED)
+        err_free_exit(factory, "[ERROR][fork] Shared memory allocation failed.");
+    sync_shared();
+    memcpy(tapes, factory->tapes, size);
+    for (i = 0; i < factory->n_tapes; i++)
+    {
+        tape_release(&factory->tapes[i]);
+        if (tapes[i].upstream) // Los enlaces del pipeline apuntan a la copia compartida
+            tapes[i].upstream = tapes + (tapes[i].upstream - factory->tapes);
+        if (tapes[i].next)
+            tapes[i].next = tapes + (tapes[i].next - factory->tapes);
+        tape_init(&tapes[i]);
+    }
+    free(factory->tapes);
+    factory->tapes = tapes;
+    factory->fork_group = group;
+}
+
+// Última cinta (sin incluir) del grupo que empieza en first
+static inline int group_end(t_factory *factory, int first)
+{
+    return (first + factory->fork_group < factory->n_tapes ? first + factory->fork_group : factory->n_tapes);
+}
+
+// Proceso de un grupo: un process_manager por cinta, como en el modo con hilos. Sale con error si
+// alguna cinta del grupo ha terminado con errores
+static void fork_child(t_factory *factory, int first)
+{
+    int *status;
+    int failed;
+    int i;
+
+    for (i = first; i < group_end(factory, first); i++)
+        safe_thread(&factory->tapes[i].tape_id, process_manager, &factory->tapes[i], NULL, CREATE);
+    failed = 0;
+    for (i = first; i < group_end(factory, first); i++)
+    {
+        safe_thread(&factory->tapes[i].tape_id, NULL, NULL, (void **)&status, JOIN);
+        failed |= *status;
+    }
+    sink_shutdown(); // Escribe la salida del grupo
+    log_shutdown(); // Vuelca los mensajes del grupo
+    _exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+// Ejecuta la fábrica con un proceso por grupo de fork_group cintas
+void run_factory_fork(t_factory *factory)
+{
+    pid_t *pids;
+    int n_groups;
+    int group;
+    int first;
+    int wstatus;
+    int i;
+
+    // Cintas más la propia fábrica; los nodos están en la arena compartida
+    for (i = 0; i < factory->n_tapes; i++)
+        factory->tapes[i].barrier_id = i;
+    barrier_init(&factory->barrier, factory->n_tapes + 1, factory->barrier.nodes);
+    n_groups = (factory->n_tapes + factory->fork_group - 1) / factory->fork_group;
+    pids = safe_malloc(n_groups * sizeof(pid_t), false);
+    log_fork_prepare();
+    sink_fork_prepare();
+    for (group = 0; group < n_groups; group++)
+    {
+        if ((pids[group] = fork()) == 0)
+        {
+            sink_fork_done(true);
+            log_fork_done(true);
+            fork_child(factory, group * factory->fork_group);
+        }
+        if (pids[group] == -1) // Sin el grupo la barrera no se completaría: se termina el resto
+        {
+            while (group--)
+                kill(pids[group], SIGKILL);
+            sink_fork_done(false);
+            log_fork_done(false);
+            err_free_exit(factory, "[ERROR][fork] Cannot create the belt processes.");
+        }
+    }
+    sink_fork_done(false);
+    log_fork_done(false);
+    for (i = 0; i < factory->n_tapes; i++)
+        log_msg(LOG_TAPE_CREATED, factory->tapes[i].id, 0);
+    barrier_wait(&factory->barrier, factory->n_tapes); // Todas las cintas están listas
+    barrier_wait(&factory->barrier, factory->n_tapes); // Todas las cintas están esperando: arrancan
+    checkpoint_start(factory);
+    metrics_start(factory);
+
+    // Resultado de cada grupo: si su proceso muere por una señal, sus cintas terminan con errores
+    for (group = 0; group < n_groups; group++)
+    {
+        while (waitpid(pids[group], &wstatus, 0) == -1 && errno == EINTR)
+            ;
+        if (!WIFSIGNALED(wstatus))
+            continue ;
+        first = group * factory->fork_group;
+        fprintf(stderr, "[ERROR][factory_manager] Process of belts %d to %d was terminated by signal %d.\n",
+            factory->tapes[first].id, factory->tapes[group_end(factory, first) - 1].id, WTERMSIG(wstatus));
+        for (i = first; i < group_end(factory, first); i++)
+            factory->tapes[i].status = -1;
+    }
+    free(pids);
+    for (i = 0; i < factory->n_tapes; i++)
+    {
+        if (!factory->tapes[i].status)
+            log_msg(LOG_TAPE_FINISHED, factory->tapes[i].id, 0);
+        else
+            fprintf(stderr, "[ERROR][factory_manager] Process_manager with id %d has finished with errors.\n", factory->tapes[i].id);
+    }
+    checkpoint_stop(factory); // Estado final de las cintas
+    metrics_stop(factory);
+    log_msg(LOG_FINISHING, 0, 0);
+}
@@ -0,0 +1,363 @@
+#include "queue.h"
+#include <time.h>
+
+// Registro de mensajes asíncrono: cada hilo escribe registros binarios compactos en su propio
+// buffer circular (un productor, un consumidor) y un hilo escritor dedicado los ordena por
+// marca de tiempo, les da formato con los mismos textos que antes imprimía printf y los vuelca a stdout.
+// Un hilo que toma una marca con log_stamp para registrarla más tarde la anuncia en su buffer: el
+// escritor no vuelca nada posterior a ella hasta que se publique, aunque el hilo pierda la CPU.
+
+// Registro binario de un mensaje: el texto se genera en el hilo escritor
+typedef struct s_log_record
+{
+    uint64_t ts; // Marca de tiempo (CLOCK_MONOTONIC, ns)
+    int32_t msg; // Tipo de mensaje (t_log_msg)
+    int32_t a; // Primer argumento del mensaje
+    int32_t b; // Segundo argumento del mensaje
+} t_log_record;
+
+// Buffer propio de un hilo
+typedef struct s_log_buffer
+{
+    _Alignas(CACHE_LINE) atomic_uint tail; // Siguiente registro a escribir (hilo propietario)
+    _Atomic uint64_t stamp; // Cota inferior de la marca de un mensaje aún sin publicar (UINT64_MAX: ninguno)
+    _Alignas(CACHE_LINE) atomic_uint head; // Siguiente registro a volcar (hilo escritor)
+    atomic_bool retired; // El hilo propietario ha terminado
+    unsigned id; // Orden de registro, desempata marcas de tiempo iguales
+    struct s_log_buffer *next;
+    t_log_record records[LOG_BUFFER_RECORDS];
+} t_log_buffer;
+
+// Registro pendiente de volcar junto con su origen, para ordenar de forma estable
+typedef struct s_log_pending
+{
+    t_log_record rec;
+    unsigned buffer;
+    unsigned pos;
+} t_log_pending;
+
+static const char *g_formats[] = {
+    [LOG_TAPE_CREATED] = "[OK][factory_manager] Process_manager with id %d has been created.\n",
+    [LOG_TAPE_WAITING] = "[OK][process_manager] Process_manager with id %d waiting to produce %d elements.\n",
+    [LOG_BELT_CREATED] = "[OK][process_manager] Belt with id %d has been created with a maximum of %d elements.\n",
+    [LOG_INTRODUCED] = "[OK][queue] Introduced element with id %d in belt %d.\n",
+    [LOG_OBTAINED] = "[OK][queue] Obtained element with id %d in belt %d.\n",
+    [LOG_TAPE_PRODUCED] = "[OK][process_manager] Process_manager with id %d has produced %d elements.\n",
+    [LOG_TAPE_FINISHED] = "[OK][factory_manager] Process_manager with id %d has finished.\n",
+    [LOG_FINISHING] = "[OK][factory_manager] Finishing.\n",
+};
+
+static int g_level = LOG_ELEMENTS; // Nivel de detalle activo
+static int g_sample = 1; // Se registra uno de cada g_sample elementos
+static bool g_running = false; // El hilo escritor está activo
+static atomic_bool g_stop; // Pide al hilo escritor que vacíe todo y termine
+static pthread_t g_writer;
+static pthread_key_t g_key; // Marca como retirado el buffer de un hilo al terminar
+static pthread_mutex_t g_mtx = PTHREAD_MUTEX_INITIALIZER; // Protege la lista de buffers
+static t_log_buffer *g_buffers = NULL;
+static unsigned g_next_id = 0;
+static __thread t_log_buffer *tls_buffer = NULL;
+// Buffer de stdout: cabe al menos PIPE_BUF bytes, de modo que stdio nunca vuelca a mitad de una línea
+// y las líneas de varios procesos (modo multiproceso) no se mezclan en la salida
+static char g_stdout_buf[2 * PIPE_BUF];
+
+// Reloj monotónico en nanosegundos usado para ordenar los mensajes
+uint64_t log_clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+// Destructor del hilo: el escritor liberará el buffer cuando lo haya vaciado
+static void log_retire(void *arg)
+{
+    atomic_store_explicit(&((t_log_buffer *)arg)->retired, true, memory_order_release);
+}
+
+// Crea y registra el buffer del hilo que llama
+static t_log_buffer *log_buffer(void)
+{
+    t_log_buffer *buf;
+
+    if (tls_buffer)
+        return (tls_buffer);
+    if (posix_memalign((void **)&buf, CACHE_LINE, sizeof(t_log_buffer)))
+        err_free_exit(NULL, "[ERROR][log] Memory allocation failed.");
+    atomic_init(&buf->tail, 0);
+    atomic_init(&buf->head, 0);
+    atomic_init(&buf->stamp, UINT64_MAX);
+    atomic_init(&buf->retired, false);
+    pthread_mutex_lock(&g_mtx);
+    buf->id = g_next_id++;
+    buf->next = g_buffers;
+    g_buffers = buf;
+    pthread_mutex_unlock(&g_mtx);
+    pthread_setspecific(g_key, buf);
+    tls_buffer = buf;
+    return (buf);
+}
+
+// Añade un registro al buffer del hilo; si está lleno espera a que el escritor lo vacíe
+static void log_push(uint64_t ts, int msg, int a, int b)
+{
+    t_log_buffer *buf;
+    t_log_record *rec;
+    unsigned tail;
+
+    buf = log_buffer();
+    tail = atomic_load_explicit(&buf->tail, memory_order_relaxed);
+    while (tail - atomic_load_explicit(&buf->head, memory_order_acquire) >= LOG_BUFFER_RECORDS)
+        sched_yield(); // Nunca se descartan mensajes: con detalle completo la salida debe ser idéntica
+    rec = &buf->records[tail % LOG_BUFFER_RECORDS];
+    rec->ts = ts;
+    rec->msg = msg;
+    rec->a = a;
+    rec->b = b;
+    atomic_store_explicit(&buf->tail, tail + 1, memory_order_release);
+}
+
+// Toma la marca de tiempo de mensajes que el hilo registrará más tarde (fuera de la sección crítica).
+// Antes de leer el reloj se anuncia una cota inferior en el buffer, que se retira al registrar
+uint64_t log_stamp(void)
+{
+    t_log_buffer *buf;
+
+    if (g_running)
+    {
+        buf = log_buffer();
+        if (atomic_load_explicit(&buf->stamp, memory_order_relaxed) == UINT64_MAX) // Se conserva la más antigua
+            atomic_store_explicit(&buf->stamp, log_clock(), memory_order_seq_cst);
+    }
+    return (log_clock());
+}
+
+// Retira la marca anunciada por el hilo una vez publicados sus mensajes
+static inline void log_unstamp(void)
+{
+    if (tls_buffer)
+        atomic_store_explicit(&tls_buffer->stamp, UINT64_MAX, memory_order_release);
+}
+
+// Indica si un mensaje de elemento supera el filtro de nivel y de muestreo
+static inline bool log_element_enabled(int num_edition)
+{
+    return (g_level >= LOG_ELEMENTS && (g_sample == 1 || num_edition % g_sample == 0));
+}
+
+// Registra un mensaje del ciclo de vida de la fábrica
+void log_msg(t_log_msg msg, int a, int b)
+{
+    if (!g_running)
+        return ;
+    if (msg == LOG_INTRODUCED || msg == LOG_OBTAINED)
+    {
+        if (!log_element_enabled(a))
+            return ;
+    }
+    else if (g_level < LOG_INFO)
+        return ;
+    log_push(log_stamp(), msg, a, b);
+    log_unstamp();
+}
+
+// Registra los mensajes de un lote de elementos con la marca de tiempo tomada (con log_stamp) dentro
+// de la sección crítica, de modo que el orden Introduced/Obtained se conserva aunque se registre fuera
+void log_elements(t_log_msg msg, const t_element *items, int n, uint64_t ts)
+{
+    int i;
+
+    if (!g_running)
+        return ;
+    if (g_level >= LOG_ELEMENTS)
+        for (i = 0; i < n; i++)
+            if (log_element_enabled(items[i].num_edition))
+                log_push(ts, msg, items[i].num_edition, items[i].id_belt);
+    log_unstamp();
+}
+
+// Orden de volcado: marca de tiempo, luego orden de registro del buffer y posición
+static int log_compare(const void *x, const void *y)
+{
+    const t_log_pending *p = x;
+    const t_log_pending *q = y;
+
+    if (p->rec.ts != q->rec.ts)
+        return (p->rec.ts < q->rec.ts ? -1 : 1);
+    if (p->buffer != q->buffer)
+        return (p->buffer < q->buffer ? -1 : 1);
+    return (p->pos < q->pos ? -1 : (p->pos > q->pos));
+}
+
+// Recoge los registros anteriores a cutoff de todos los buffers, los ordena y los escribe. El corte
+// se adelanta a la marca anunciada más antigua. Los buffers retirados y vacíos se liberan.
+// Devuelve el número de registros escritos
+static size_t log_drain(uint64_t cutoff, t_log_pending **pending, size_t *capacity)
+{
+    t_log_buffer **link;
+    t_log_buffer *buf;
+    unsigned head;
+    unsigned tail;
+    size_t count;
+    size_t i;
+    int written; // Bytes en el buffer de stdout desde el último volcado
+
+    count = 0;
+    pthread_mutex_lock(&g_mtx);
+    // El reloj del corte se leyó antes: una marca anunciada después de esta pasada es posterior al corte
+    for (buf = g_buffers; buf && cutoff != UINT64_MAX; buf = buf->next)
+    {
+        uint64_t stamp = atomic_load_explicit(&buf->stamp, memory_order_seq_cst);
+
+        if (stamp <= cutoff)
+            cutoff = stamp - 1;
+    }
+    link = &g_buffers;
+    while ((buf = *link))
+    {
+        bool retired = atomic_load_explicit(&buf->retired, memory_order_acquire);
+
+        head = atomic_load_explicit(&buf->head, memory_order_relaxed);
+        tail = atomic_load_explicit(&buf->tail, memory_order_acquire);
+        if (retired && head == tail) // Hilo terminado y sin mensajes pendientes
+        {
+            *link = buf->next;
+            free(buf);
+            continue ;
+        }
+        if (count + (tail - head) > *capacity)
+        {
+            *capacity = (count + (tail - head)) * 2;
+            if (!(*pending = realloc(*pending, *capacity * sizeof(t_log_pending))))
+                err_free_exit(NULL, "[ERROR][log] Memory allocation failed.");
+        }
+        for (; head != tail; head++)
+        {
+            t_log_record *rec = &buf->records[head % LOG_BUFFER_RECORDS];
+
+            if (rec->ts > cutoff) // Los mensajes de un buffer están en orden: el resto es más reciente
+                break ;
+            (*pending)[count].rec = *rec;
+            (*pending)[count].buffer = buf->id;
+            (*pending)[count].pos = head;
+            count++;
+        }
+        atomic_store_explicit(&buf->head, head, memory_order_release);
+        link = &buf->next;
+    }
+    pthread_mutex_unlock(&g_mtx);
+    qsort(*pending, count, sizeof(t_log_pending), log_compare);
+    for (i = 0, written = 0; i < count; i++)
+    {
+        if (written + LOG_LINE_MAX > PIPE_BUF) // Cada write lleva líneas enteras y es atómico
+        {
+            fflush(stdout);
+            written = 0;
+        }
+        written += printf(g_formats[(*pending)[i].rec.msg], (*pending)[i].rec.a, (*pending)[i].rec.b);
+    }
+    if (count)
+        fflush(stdout);
+    return (count);
+}
+
+// Hilo escritor: vuelca periódicamente los mensajes con una antigüedad mínima de LOG_GRACE_NS,
+// margen que deja a los hilos publicar los mensajes cuya marca de tiempo ya se tomó sin anunciarla
+static void *log_writer(void *arg)
+{
+    t_log_pending *pending;
+    size_t capacity;
+    struct timespec idle;
+
+    (void)arg;
+    pending = NULL;
+    capacity = 0;
+    idle.tv_sec = 0;
+    idle.tv_nsec = LOG_IDLE_NS;
+    while (!atomic_load_explicit(&g_stop, memory_order_acquire))
+    {
+        if (log_drain(log_clock() - LOG_GRACE_NS, &pending, &capacity))
+        {
+            idle.tv_nsec = LOG_IDLE_NS;
+            continue ;
+        }
+        nanosleep(&idle, NULL);
+        // Sin mensajes, la espera se alarga: con muchos procesos (modo multiproceso) cada uno tiene su
+        // escritor y no deben repartirse la CPU despertando en vano
+        if (idle.tv_nsec < LOG_IDLE_MAX_NS)
+            idle.tv_nsec = idle.tv_nsec * 2 < LOG_IDLE_MAX_NS ? idle.tv_nsec * 2 : LOG_IDLE_MAX_NS;
+    }
+    while (log_drain(UINT64_MAX, &pending, &capacity)) // Vaciado final
+        ;
+    free(pending);
+    return (NULL);
+}
+
+// Arranca el registro con el nivel de detalle y el muestreo de elementos indicados
+void log_init(int level, int sample)
+{
+    g_level = level;
+    g_sample = sample > 0 ? sample : 1;
+    if (level <= LOG_QUIET || g_running)
+        return ;
+    setvbuf(stdout, g_stdout_buf, _IOFBF, sizeof(g_stdout_buf));
+    if (pthread_key_create(&g_key, log_retire))
+        err_free_exit(NULL, "[ERROR][log] Logger initialization failed.");
+    atomic_init(&g_stop, false);
+    if (pthread_create(&g_writer, NULL, log_writer, NULL))
+        err_free_exit(NULL, "[ERROR][log] Logger initialization failed.");
+    g_running = true;
+}
+
+// Antes de fork: nadie puede tener la lista de buffers ni stdout a medias al duplicarse el proceso, y
+// stdout queda vacío para que el hijo no repita lo que el padre ya tenía pendiente de escribir
+void log_fork_prepare(void)
+{
+    if (g_running)
+        pthread_mutex_lock(&g_mtx);
+    flockfile(stdout);
+    fflush(stdout);
+}
+
+// Después de fork. En el hijo el hilo escritor no existe y los buffers heredados son copias de los
+// del padre, que ya los vuelca él: el registro del hijo empieza de cero con su propio escritor
+void log_fork_done(bool child)
+{
+    t_log_buffer *buf;
+
+    funlockfile(stdout);
+    if (!g_running)
+        return ;
+    pthread_mutex_unlock(&g_mtx);
+    if (!child)
+        return ;
+    while ((buf = g_buffers))
+    {
+        g_buffers = buf->next;
+        free(buf);
+    }
+    tls_buffer = NULL;
+    atomic_store_explicit(&g_stop, false, memory_order_relaxed);
+    if (pthread_create(&g_writer, NULL, log_writer, NULL))
+        err_free_exit(NULL, "[ERROR][log] Logger initialization failed.");
+}
+
+// Vacía todos los mensajes pendientes y detiene el hilo escritor
+void log_shutdown(void)
+{
+    t_log_buffer *buf;
+
+    if (!g_running || pthread_equal(pthread_self(), g_writer))
+        return ;
+    g_running = false;
+    atomic_store_explicit(&g_stop, true, memory_order_release);
+    pthread_join(g_writer, NULL);
+    pthread_key_delete(g_key);
+    while ((buf = g_buffers)) // Los buffers de hilos que siguen vivos (el principal) ya están vacíos
+    {
+        g_buffers = buf->next;
+        free(buf);
+    }
+    tls_buffer = NULL;
+}
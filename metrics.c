@@ -0,0 +1,213 @@
+#include "queue.h"
+#include <errno.h>
+#include <time.h>
+
+// Métricas de la fábrica en marcha (opción -m). Un hilo lee cada intervalo los contadores de cada
+// cinta sin tomar queue_mtx ni tocar los índices de las colas (lecturas atómicas relajadas de lo que
+// ya mantienen productor y consumidor), así que el camino caliente no cambia. Las escribe en formato
+// de texto de Prometheus en un fichero temporal que después se renombra sobre el destino: un lector
+// siempre ve una muestra completa. Los valores de una cinta mutex pueden mezclar dos instantes
+// cercanos; se ajustan para que sigan siendo coherentes entre sí.
+
+#define METRICS_TMP ".tmp" // Sufijo del fichero que se escribe antes de renombrarlo
+
+// Contadores de una cinta en el momento de la muestra
+typedef struct s_belt_sample
+{
+    int produced; // Elementos insertados en la cinta
+    int obtained; // Elementos obtenidos de la cinta
+    int size; // Elementos en cola
+    int capacity;
+} t_belt_sample;
+
+// Lee los contadores de una cinta sin detenerla
+static void metrics_sample(t_tape *queue, t_belt_sample *out)
+{
+    out->capacity = __atomic_load_n(&queue->max_size, __ATOMIC_RELAXED);
+    if (queue->impl == QUEUE_SPSC) // Posiciones publicadas del anillo
+    {
+        out->obtained = queue->ckpt_base + atomic_load_explicit(&queue->ring_head, memory_order_relaxed);
+        out->produced = queue->ckpt_base + atomic_load_explicit(&queue->ring_tail, memory_order_relaxed);
+    }
+    else if (queue->impl == QUEUE_MPMC)
+    {
+        out->obtained = atomic_load_explicit(&queue->deq_pos, memory_order_relaxed);
+        out->produced = atomic_load_explicit(&queue->enq_pos, memory_order_relaxed);
+    }
+    else // Contadores que el modo mutex cambia con queue_mtx tomado
+    {
+        out->produced = __atomic_load_n(&queue->num_created, __ATOMIC_RELAXED);
+        out->obtained = out->produced - __atomic_load_n(&queue->size, __ATOMIC_RELAXED);
+    }
+    if (out->obtained > out->produced) // Lecturas de instantes distintos
+        out->obtained = out->produced;
+    if (out->obtained < out->produced - out->capacity)
+        out->obtained = out->produced - out->capacity;
+    out->size = out->produced - out->obtained;
+}
+
+// Escribe una métrica con su ayuda y su tipo y el valor de cada cinta. field es el desplazamiento
+// del valor dentro de t_belt_sample
+static void metrics_family(FILE *out, const char *name, const char *help, const char *type,
+    t_factory *factory, t_belt_sample *samples, size_t field)
+{
+    int i;
+
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+    for (i = 0; i < factory->n_tapes; i++)
+        fprintf(out, "%s{belt=\"%d\"} %d\n", name, factory->tapes[i].id, *(int *)((char *)&samples[i] + field));
+}
+
+#ifdef FACTORY_STATS
+// Esperas de un lado de las cintas (solo con FACTORY_STATS): veces y segundos
+static void metrics_waits(FILE *out, const char *side, const char *help, t_factory *factory, size_t field)
+{
+    t_wait_stats *wait;
+    int i;
+
+    fprintf(out, "# HELP factory_belt_%s_waits_total Times the %s.\n", side, help);
+    fprintf(out, "# TYPE factory_belt_%s_waits_total counter\n", side);
+    for (i = 0; i < factory->n_tapes; i++)
+    {
+        wait = (t_wait_stats *)((char *)&factory->tapes[i] + field);
+        fprintf(out, "factory_belt_%s_waits_total{belt=\"%d\"} %llu\n", side, factory->tapes[i].id,
+            (unsigned long long)__atomic_load_n(&wait->count, __ATOMIC_RELAXED));
+    }
+    fprintf(out, "# HELP factory_belt_%s_wait_seconds_total Seconds the %s.\n", side, help);
+    fprintf(out, "# TYPE factory_belt_%s_wait_seconds_total counter\n", side);
+    for (i = 0; i < factory->n_tapes; i++)
+    {
+        wait = (t_wait_stats *)((char *)&factory->tapes[i] + field);
+        fprintf(out, "factory_belt_%s_wait_seconds_total{belt=\"%d\"} %.6f\n", side, factory->tapes[i].id,
+            __atomic_load_n(&wait->ns, __ATOMIC_RELAXED) / 1e9);
+    }
+}
+#endif
+
+// Escribe una muestra de todas las cintas y la sustituye de una vez por la anterior
+static void metrics_write(t_factory *factory)
+{
+    t_metrics *metrics;
+    t_belt_sample *samples;
+    FILE *out;
+    int i;
+
+    metrics = &factory->metrics;
+    if (!(out = fopen(metrics->tmp, "w")))
+        return ; // Se intentará de nuevo en la siguiente muestra
+    samples = safe_malloc((factory->n_tapes ? factory->n_tapes : 1) * sizeof(t_belt_sample), false);
+    for (i = 0; i < factory->n_tapes; i++)
+        metrics_sample(&factory->tapes[i], &samples[i]);
+    fprintf(out, "# HELP factory_uptime_seconds Time since the belts started.\n# TYPE factory_uptime_seconds gauge\n");
+    fprintf(out, "factory_uptime_seconds %.3f\n", (log_clock() - metrics->start_ns) / 1e9);
+    metrics_family(out, "factory_belt_produced_total", "Elements put on the belt.", "counter",
+        factory, samples, offsetof(t_belt_sample, produced));
+    metrics_family(out, "factory_belt_obtained_total", "Elements taken from the belt.", "counter",
+        factory, samples, offsetof(t_belt_sample, obtained));
+    metrics_family(out, "factory_belt_size", "Elements waiting on the belt.", "gauge",
+        factory, samples, offsetof(t_belt_sample, size));
+    metrics_family(out, "factory_belt_capacity", "Current capacity of the belt.", "gauge",
+        factory, samples, offsetof(t_belt_sample, capacity));
+    fprintf(out, "# HELP factory_belt_elements Elements the belt has to produce.\n# TYPE factory_belt_elements gauge\n");
+    for (i = 0; i < factory->n_tapes; i++)
+        fprintf(out, "factory_belt_elements{belt=\"%d\"} %d\n", factory->tapes[i].id, factory->tapes[i].num_elements);
+#ifdef FACTORY_STATS
+    metrics_waits(out, "full", "producer waited on a full belt", factory, offsetof(t_tape, full_wait));
+    metrics_waits(out, "empty", "consumer waited for elements", factory, offsetof(t_tape, empty_wait));
+#endif
+    free(samples);
+    if (fclose(out) == 0)
+        rename(metrics->tmp, metrics->path); // Los lectores ven la muestra anterior o esta, completa
+}
+
+// Hilo de las métricas: una muestra cada interval_ms hasta que termina la fábrica
+static void *metrics_loop(void *arg)
+{
+    t_factory *factory;
+    t_metrics *metrics;
+    struct timespec deadline;
+
+    factory = arg;
+    metrics = &factory->metrics;
+    safe_mutex(&metrics->mtx, LOCK);
+    while (!metrics->stop)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += metrics->interval_ms / 1000;
+        deadline.tv_nsec += (long)(metrics->interval_ms % 1000) * 1000000;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000;
+        deadline.tv_nsec %= 1000000000;
+        while (!metrics->stop && pthread_cond_timedwait(&metrics->wake, &metrics->mtx, &deadline) != ETIMEDOUT)
+            ;
+        if (metrics->stop)
+            break ;
+        safe_mutex(&metrics->mtx, UNLOCK);
+        metrics_write(factory);
+        safe_mutex(&metrics->mtx, LOCK);
+    }
+    safe_mutex(&metrics->mtx, UNLOCK);
+    return (NULL);
+}
+
+// Prepara las métricas en path con una muestra cada interval_ms. Se llama tras crear la fábrica,
+// antes de run_factory
+void metrics_open(t_factory *factory, const char *path, int interval_ms)
+{
+    t_metrics *metrics;
+    FILE *out;
+
+    metrics = &factory->metrics;
+    metrics->tmp = safe_malloc(strlen(path) + sizeof(METRICS_TMP), false);
+    strcpy(metrics->tmp, path);
+    strcat(metrics->tmp, METRICS_TMP);
+    if (!(out = fopen(metrics->tmp, "w"))) // El directorio debe admitir el fichero temporal
+    {
+        free(metrics->tmp);
+        metrics->tmp = NULL;
+        err_free_exit(factory, "[ERROR][metrics] Cannot open the metrics file.");
+    }
+    fclose(out);
+    unlink(metrics->tmp);
+    metrics->path = path;
+    metrics->interval_ms = interval_ms;
+    safe_mutex(&metrics->mtx, INIT);
+    safe_cond(&metrics->wake, NULL, INIT);
+}
+
+// Arranca el hilo de las métricas cuando las colas de las cintas ya están preparadas
+void metrics_start(t_factory *factory)
+{
+    if (!factory->metrics.path)
+        return ;
+    factory->metrics.stop = false;
+    factory->metrics.start_ns = log_clock();
+    metrics_write(factory); // Primera muestra, con las cintas a punto de arrancar
+    safe_thread(&factory->metrics.thread, metrics_loop, factory, NULL, CREATE);
+}
+
+// Detiene el hilo y escribe la muestra final, con las cintas ya terminadas
+void metrics_stop(t_factory *factory)
+{
+    t_metrics *metrics;
+
+    metrics = &factory->metrics;
+    if (!metrics->path)
+        return ;
+    safe_mutex(&metrics->mtx, LOCK);
+    metrics->stop = true;
+    safe_cond(&metrics->wake, NULL, SIGNAL);
+    safe_mutex(&metrics->mtx, UNLOCK);
+    safe_thread(&metrics->thread, NULL, NULL, NULL, JOIN);
+    metrics_write(factory);
+}
+
+// Libera las métricas (free_all); el último fichero escrito se conserva
+void metrics_close(t_metrics *metrics)
+{
+    if (!metrics->path)
+        return ;
+    free(metrics->tmp);
+    metrics->path = NULL;
+    safe_cond(&metrics->wake, NULL, DESTROY);
+    safe_mutex(&metrics->mtx, DESTROY);
+}
@@ -0,0 +1,383 @@
+#include "queue.h"
+#include <sys/mman.h>
+
+// Analizador del fichero de entrada. El fichero se proyecta en memoria y se valida y trocea en una
+// sola pasada, sin copiar el texto: los números se convierten con un lector de enteros propio y los
+// atributos se comparan directamente sobre el texto proyectado. Los errores indican línea y columna.
+
+// Posición de lectura sobre el texto
+typedef struct s_cursor
+{
+    const char *ptr;
+    const char *end;
+    const char *line_start; // Inicio de la línea actual, para calcular la columna
+    int line;
+} t_cursor;
+
+// Atributos que solo se pueden validar con la cinta completa
+typedef struct s_attrs
+{
+    bool mode_set; // Hay un "mode=" explícito
+    bool producers_set; // Hay un "producers=" explícito
+    bool has_from; // La cinta recibe los elementos de otra ("from=")
+    bool resize; // La capacidad se adapta en marcha ("resize=")
+    bool wake; // Marcas de ocupación del consumidor y el productor ("wake=")
+    bool order; // Hay un "order=" explícito
+    int from; // Id de la cinta anterior del pipeline
+} t_attrs;
+
+// Guarda el primer error encontrado con su posición
+static bool parse_fail(t_cursor *cur, const char *at, t_parse_error *err, const char *msg)
+{
+    err->line = cur->line;
+    err->column = (int)(at - cur->line_start) + 1;
+    err->msg = msg;
+    return (false);
+}
+
+// Salta espacios y saltos de línea llevando la cuenta de las líneas
+static void skip_spaces(t_cursor *cur)
+{
+    while (cur->ptr < cur->end && isspace((unsigned char)*cur->ptr))
+    {
+        if (*cur->ptr == '\n')
+        {
+            cur->line++;
+            cur->line_start = cur->ptr + 1;
+        }
+        cur->ptr++;
+    }
+}
+
+// Indica si el carácter actual termina un token
+static inline bool token_end(t_cursor *cur)
+{
+    return (cur->ptr == cur->end || isspace((unsigned char)*cur->ptr));
+}
+
+// Lee un entero no negativo separado por espacios; falla si hay otros caracteres o si desborda un int
+static bool scan_int(t_cursor *cur, int *value, t_parse_error *err)
+{
+    const char *start;
+    long acc;
+
+    skip_spaces(cur);
+    start = cur->ptr;
+    if (cur->ptr == cur->end)
+        return (parse_fail(cur, start, err, "unexpected end of file"));
+    if (!isdigit((unsigned char)*cur->ptr))
+        return (parse_fail(cur, start, err, "expected a number"));
+    acc = 0;
+    while (cur->ptr < cur->end && isdigit((unsigned char)*cur->ptr))
+    {
+        acc = acc * 10 + (*cur->ptr++ - '0');
+        if (acc > INT_MAX)
+            return (parse_fail(cur, start, err, "number out of range"));
+    }
+    if (!token_end(cur))
+        return (parse_fail(cur, cur->ptr, err, "unexpected character"));
+    *value = (int)acc;
+    return (true);
+}
+
+// Compara un trozo del texto con una cadena terminada en nulo
+static inline bool span_eq(const char *span, size_t len, const char *str)
+{
+    return (strlen(str) == len && !memcmp(span, str, len));
+}
+
+// Convierte un trozo del texto en un entero entre min y max
+static bool span_int(const char *span, size_t len, int min, int max, int *value)
+{
+    long acc;
+    size_t i;
+
+    for (i = 0, acc = 0; i < len && isdigit((unsigned char)span[i]) && acc <= max; i++)
+        acc = acc * 10 + (span[i] - '0');
+    if (!len || i < len || acc < min || acc > max)
+        return (false);
+    *value = (int)acc;
+    return (true);
+}
+
+// Convierte una lista de CPU ("0,2,4-7") en el conjunto de la cinta
+static bool span_cpus(const char *span, size_t len, cpu_set_t *cpus)
+{
+    const char *end;
+    size_t item;
+    size_t dash;
+    int first;
+    int last;
+
+    CPU_ZERO(cpus);
+    end = span + len;
+    while (span < end)
+    {
+        for (item = 0; span + item < end && span[item] != ','; item++)
+            ;
+        for (dash = 0; dash < item && span[dash] != '-'; dash++)
+            ;
+        if (!span_int(span, dash, 0, CPU_SETSIZE - 1, &first))
+            return (false);
+        last = first;
+        if (dash < item && !span_int(span + dash + 1, item - dash - 1, first, CPU_SETSIZE - 1, &last))
+            return (false);
+        while (first <= last)
+            CPU_SET(first++, cpus);
+        span += item + (span + item < end); // Salta la coma
+        if (span == end && span[-1] == ',') // Lista terminada en coma
+            return (false);
+    }
+    return (CPU_COUNT(cpus) > 0);
+}
+
+// Convierte un intervalo "min-max" de enteros positivos
+static bool span_range(const char *span, size_t len, int *min, int *max)
+{
+    size_t dash;
+
+    for (dash = 0; dash < len && span[dash] != '-'; dash++)
+        ;
+    return (dash < len && span_int(span, dash, 1, INT_MAX, min)
+        && span_int(span + dash + 1, len - dash - 1, *min, INT_MAX, max));
+}
+
+// Aplica un atributo opcional "clave=valor" a la cinta que se está leyendo
+static bool parse_attribute(const char *key, size_t key_len, const char *value, size_t value_len,
+    t_tape *tape, t_attrs *attrs)
+{
+    if (span_eq(key, key_len, "producers"))
+        return (attrs->producers_set = true, span_int(value, value_len, 1, BELT_MAX_THREADS, &tape->producers));
+    if (span_eq(key, key_len, "consumers"))
+        return (span_int(value, value_len, 1, BELT_MAX_THREADS, &tape->consumers));
+    if (span_eq(key, key_len, "from"))
+        return (attrs->has_from = true, span_int(value, value_len, 0, INT_MAX, &attrs->from));
+    if (span_eq(key, key_len, "cpus"))
+        return (tape->pinned = true, span_cpus(value, value_len, &tape->cpus));
+    if (span_eq(key, key_len, "resize"))
+        return (attrs->resize = true, span_range(value, value_len, &tape->size_min, &tape->size_max));
+    if (span_eq(key, key_len, "wake"))
+        return (attrs->wake = true, span_range(value, value_len, &tape->wake_low, &tape->wake_high));
+    if (span_eq(key, key_len, "timeout"))
+        return (span_int(value, value_len, 1, INT_MAX, &tape->wait_us));
+    if (span_eq(key, key_len, "group"))
+        return (span_int(value, value_len, 1, INT_MAX, &tape->group));
+    if (span_eq(key, key_len, "priority"))
+        return (span_int(value, value_len, 0, PRIORITY_MAX, &tape->priority));
+    if (span_eq(key, key_len, "rate"))
+        return (span_int(value, value_len, 1, INT_MAX, &tape->rate));
+    if (span_eq(key, key_len, "order"))
+    {
+        attrs->order = true;
+        if (span_eq(value, value_len, "strict"))
+            tape->ordered = true;
+        else if (!span_eq(value, value_len, "relaxed"))
+            return (false);
+        return (true);
+    }
+    if (span_eq(key, key_len, "stage"))
+        return ((tape->stage = stage_find(value, value_len)) != NULL);
+    if (span_eq(key, key_len, "mode"))
+    {
+        attrs->mode_set = true;
+        if (span_eq(value, value_len, "mutex"))
+            tape->mode = QUEUE_MUTEX;
+        else if (span_eq(value, value_len, "spsc"))
+            tape->mode = QUEUE_SPSC;
+        else if (span_eq(value, value_len, "mpmc"))
+            tape->mode = QUEUE_MPMC;
+        else
+            return (false);
+        return (true);
+    }
+    return (false);
+}
+
+// Lee los atributos opcionales que siguen a la terna "id tamaño elementos" de una cinta
+static bool parse_attributes(t_cursor *cur, t_tape *tape, t_attrs *attrs, t_parse_error *err)
+{
+    const char *start;
+    const char *equal;
+
+    memset(attrs, 0, sizeof(t_attrs));
+    tape->mode = QUEUE_MUTEX;
+    tape->producers = 1;
+    tape->consumers = 1;
+    while (true)
+    {
+        skip_spaces(cur);
+        if (cur->ptr == cur->end || !isalpha((unsigned char)*cur->ptr)) // Fin o siguiente terna
+            return (true);
+        start = cur->ptr;
+        equal = NULL;
+        while (!token_end(cur))
+        {
+            if (*cur->ptr == '=' && !equal)
+                equal = cur->ptr;
+            cur->ptr++;
+        }
+        if (!equal || !parse_attribute(start, equal - start, equal + 1, cur->ptr - equal - 1, tape, attrs))
+            return (parse_fail(cur, start, err, "invalid belt attribute"));
+    }
+}
+
+// Enlaza la cinta con la anterior del pipeline, que debe estar declarada antes (así no hay ciclos)
+static const char *link_belt(t_factory *factory, t_tape *tape, t_attrs *attrs)
+{
+    t_tape *upstream;
+    int i;
+
+    for (i = 0; i < factory->n_tapes && factory->tapes[i].id != attrs->from; i++)
+        ;
+    if (i == factory->n_tapes)
+        return ("unknown upstream belt (it must be declared before)");
+    upstream = &factory->tapes[i];
+    if (upstream->next)
+        return ("upstream belt already feeds another belt");
+    if (upstream->group || tape->group)
+        return ("grouped belts cannot be part of a pipeline");
+    if (attrs->producers_set)
+        return ("a belt fed by another belt has no producers of its own");
+    if (upstream->num_elements != tape->num_elements)
+        return ("pipeline belts must have the same number of elements");
+    upstream->next = tape;
+    tape->upstream = upstream;
+    tape->producers = upstream->consumers; // Los consumidores de la anterior producen en esta
+    atomic_init(&tape->feeders, upstream->consumers);
+    return (NULL);
+}
+
+// Valida la cinta completa y resuelve su modo. Devuelve el error o NULL
+static const char *check_belt(t_factory *factory, t_tape *tape, t_attrs *attrs)
+{
+    const char *msg;
+
+    if (tape->max_size <= 0 || tape->num_elements <= 0)
+        return ("belt size and number of elements must be positive");
+    if (attrs->has_from && (msg = link_belt(factory, tape, attrs)))
+        return (msg);
+    if (tape->rate && tape->upstream)
+        return ("only belts that generate their elements can be rate limited");
+    // Sin "mode=", una cinta con varios productores o consumidores usa el anillo MPMC
+    if ((tape->producers > 1 || tape->consumers > 1) && !attrs->mode_set)
+        tape->mode = QUEUE_MPMC;
+    if ((tape->producers > 1 || tape->consumers > 1) && tape->mode != QUEUE_MPMC)
+        return ("only mpmc belts can have several producers or consumers");
+    if (!attrs->resize) // Capacidad fija
+    {
+        tape->size_min = tape->max_size;
+        tape->size_max = tape->max_size;
+    }
+    else if (tape->mode != QUEUE_MUTEX)
+        return ("only mutex belts can be resized");
+    else if (tape->max_size < tape->size_min || tape->max_size > tape->size_max)
+        return ("the belt size must be within its resize bounds");
+    if ((attrs->wake || tape->wait_us) && tape->mode != QUEUE_MUTEX)
+        return ("only mutex belts have watermarks and timeouts");
+    if (attrs->order && !tape->group)
+        return ("only grouped belts have an ordering");
+    if (tape->wake_high > tape->size_max)
+        return ("the high watermark must be within the belt size");
+    return (NULL);
+}
+
+// Crea la fábrica vacía con sitio para max_tapes cintas (sin crear)
+t_factory *factory_create(int max_tapes)
+{
+    t_factory *factory;
+
+    factory = safe_malloc(sizeof(t_factory), false); // Asigna memoria para la fábrica
+    factory->max_tapes = max_tapes;
+    factory->tapes = safe_aligned_malloc(max_tapes * sizeof(t_tape)); // Cintas alineadas a línea de caché
+    factory->n_tapes = 0;
+    factory->batch_size = DEFAULT_BATCH;
+    factory->pool = NULL;
+    factory->affinity = AFFINITY_NONE;
+#ifdef FACTORY_STATS
+    factory->stats_out = NULL;
+#endif
+    factory->barrier.nodes = NULL; // La barrera se crea al arrancar las cintas
+    memset(&factory->arena, 0, sizeof(t_arena)); // La arena se reparte en run_factory
+    memset(&factory->checkpoint, 0, sizeof(t_checkpoint)); // Sin puntos de control salvo con -c
+    memset(&factory->metrics, 0, sizeof(t_metrics)); // Sin métricas salvo con -m
+    factory->fork_group = 0; // Hilos en un solo proceso salvo con -f
+    factory->priority_top = 0;
+    return (factory);
+}
+
+// Analiza una configuración completa en memoria. Devuelve la fábrica o NULL rellenando err
+t_factory *parse_buffer(const char *data, size_t len, t_parse_error *err)
+{
+    t_cursor cur;
+    t_cursor belt; // Posición de la terna de la cinta en curso, para los errores de la cinta completa
+    t_factory *factory;
+    t_tape *tape;
+    const char *start;
+    const char *msg;
+    t_attrs attrs;
+    int max_tapes;
+
+    cur.ptr = data;
+    cur.end = data + len;
+    cur.line_start = data;
+    cur.line = 1;
+    if (!scan_int(&cur, &max_tapes, err))
+        return (NULL);
+    if (max_tapes <= 0)
+        return (parse_fail(&cur, cur.ptr - 1, err, "the number of belts must be positive"), NULL);
+    factory = factory_create(max_tapes);
+    while (skip_spaces(&cur), cur.ptr < cur.end)
+    {
+        start = cur.ptr;
+        belt = cur;
+        if (factory->n_tapes >= factory->max_tapes)
+        {
+            parse_fail(&cur, start, err, "more belts than declared");
+            return (free_all(factory), NULL);
+        }
+        tape = &factory->tapes[factory->n_tapes];
+        memset(tape, 0, sizeof(t_tape));
+        if (!scan_int(&cur, &tape->id, err) || !scan_int(&cur, &tape->max_size, err)
+            || !scan_int(&cur, &tape->num_elements, err) || !parse_attributes(&cur, tape, &attrs, err))
+            return (free_all(factory), NULL);
+        if ((msg = check_belt(factory, tape, &attrs)))
+        {
+            parse_fail(&belt, start, err, msg);
+            return (free_all(factory), NULL);
+        }
+        tape->factory = factory;
+        tape_init(tape);
+        factory->n_tapes++; // Agrega la cinta a la fábrica
+    }
+    return (factory);
+}
+
+// Proyecta el fichero de entrada en memoria y crea la fábrica; termina el programa si no es válido
+t_factory *parser(const char *filename)
+{
+    t_parse_error err;
+    t_factory *factory;
+    struct stat st;
+    void *data;
+    int fd;
+
+    if ((fd = open(filename, O_RDONLY)) == -1 || fstat(fd, &st) == -1 || st.st_size == 0)
+    {
+        if (fd != -1)
+            close(fd);
+        err_free_exit(NULL, "[ERROR][factory_manager] Invalid file.");
+    }
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        err_free_exit(NULL, "[ERROR][factory_manager] Invalid file.");
+    madvise(data, st.st_size, MADV_SEQUENTIAL); // Lectura secuencial: lectura anticipada agresiva
+    factory = parse_buffer(data, st.st_size, &err);
+    munmap(data, st.st_size);
+    if (!factory)
+    {
+        fprintf(stderr, "[ERROR][factory_manager] Invalid file (line %d, column %d: %s).\n", err.line, err.column, err.msg);
+        err_free_exit(NULL, NULL);
+    }
+    return (factory);
+}
@@ -0,0 +1,84 @@
+#include "queue.h"
+
+// Registro de etapas de procesamiento de los pipelines. Una cinta con "stage=nombre" ejecuta la
+// etapa en sus consumidores y, si otra cinta la declara con "from=id", le pasa después los elementos.
+// Las etapas propias se registran con stage_register antes de analizar el fichero de entrada.
+
+// Suma uno al dato de cada elemento (sin signo: tras "hash" el dato puede valer INT64_MAX)
+static void stage_inc(t_element *items, int n, void *arg)
+{
+    int i;
+
+    (void)arg;
+    for (i = 0; i < n; i++)
+        items[i].payload = (int64_t)((uint64_t)items[i].payload + 1);
+}
+
+// Eleva al cuadrado el dato de cada elemento. Se multiplica sin signo: encadenada o tras "hash" el
+// cuadrado desborda y, con signo, el desbordamiento sería indefinido; así da la vuelta módulo 2^64
+static void stage_square(t_element *items, int n, void *arg)
+{
+    int i;
+
+    (void)arg;
+    for (i = 0; i < n; i++)
+        items[i].payload = (int64_t)((uint64_t)items[i].payload * (uint64_t)items[i].payload);
+}
+
+// Mezcla el dato STAGE_HASH_ROUNDS veces (splitmix64): simula una etapa con carga de CPU
+static void stage_hash(t_element *items, int n, void *arg)
+{
+    uint64_t x;
+    int round;
+    int i;
+
+    (void)arg;
+    for (i = 0; i < n; i++)
+    {
+        x = (uint64_t)items[i].payload;
+        for (round = 0; round < STAGE_HASH_ROUNDS; round++)
+        {
+            x += 0x9e3779b97f4a7c15ull;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+            x ^= x >> 31;
+        }
+        items[i].payload = (int64_t)x;
+    }
+}
+
+static t_stage g_stages[STAGE_MAX] = {
+    {"inc", stage_inc, NULL},
+    {"square", stage_square, NULL},
+    {"hash", stage_hash, NULL},
+};
+static int g_n_stages = 3;
+
+// Registra una etapa (o sustituye la del mismo nombre). Devuelve -1 si el registro está lleno.
+// El nombre no se copia y debe seguir siendo válido mientras se use la fábrica
+int stage_register(const char *name, t_stage_fn fn, void *arg)
+{
+    int i;
+
+    for (i = 0; i < g_n_stages && strcmp(g_stages[i].name, name); i++)
+        ;
+    if (i == STAGE_MAX)
+        return (-1);
+    g_stages[i].name = name;
+    g_stages[i].fn = fn;
+    g_stages[i].arg = arg;
+    if (i == g_n_stages)
+        g_n_stages++;
+    return (0);
+}
+
+// Busca una etapa por nombre (trozo del texto de entrada, sin terminar en nulo)
+const t_stage *stage_find(const char *name, size_t len)
+{
+    int i;
+
+    for (i = 0; i < g_n_stages; i++)
+        if (strlen(g_stages[i].name) == len && !memcmp(g_stages[i].name, name, len))
+            return (&g_stages[i]);
+    return (NULL);
+}
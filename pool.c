@@ -0,0 +1,375 @@
+#include "queue.h"
+
+// Planificador de cintas con un número fijo de hilos trabajadores. Cada cinta (o cada pipeline de
+// cintas enlazadas) es una tarea cooperativa: belt_step ejecuta un turno de productor y consumidor
+// sin bloquearse y la tarea vuelve a la deque del trabajador. Cada trabajador tiene una deque de
+// Chase-Lev (push/take del propietario por abajo, steal del resto por arriba) y las cintas nuevas
+// llegan a través de una cola de inyección protegida por mutex.
+
+// Deque de Chase-Lev de capacidad fija
+typedef struct s_deque
+{
+    _Alignas(CACHE_LINE) atomic_long top; // Extremo de robo
+    _Alignas(CACHE_LINE) atomic_long bottom; // Extremo del propietario
+    _Atomic(t_tape *) tasks[POOL_DEQUE_SIZE];
+} t_deque;
+
+typedef struct s_worker
+{
+    t_deque deque;
+    t_pool *pool;
+    pthread_t thread;
+    unsigned seed; // Semilla para elegir víctimas de robo
+    t_element *items; // Lote local para productor y consumidor
+    int items_len;
+    t_tape *later; // Cintas apartadas por falta de fichas (lista enlazada por t_tape.later)
+    uint64_t later_min; // Primer not_before_ns de las cintas apartadas
+} t_worker;
+
+struct s_pool
+{
+    int n_workers;
+    t_worker *workers;
+    _Alignas(CACHE_LINE) atomic_uint epoch; // Futex en el que duermen los trabajadores ociosos
+    atomic_int idle; // Trabajadores dormidos o a punto de dormir
+    atomic_bool stop;
+    _Alignas(CACHE_LINE) atomic_uint remaining; // Cintas de la ejecución actual sin terminar
+    pthread_mutex_t inject_mtx; // Protege la cola de inyección
+    t_tape **inject; // Cintas pendientes de repartir
+    _Atomic int inject_head; // Se cambian con inject_mtx; fuera de él solo se leen como pista
+    _Atomic int inject_len;
+};
+
+// Inserta una tarea por abajo (solo el propietario); devuelve el número de tareas de la deque
+static long deque_push(t_deque *deque, t_tape *task)
+{
+    long bottom;
+    long top;
+
+    bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_store_explicit(&deque->tasks[bottom & (POOL_DEQUE_SIZE - 1)], task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return (bottom + 1 - top);
+}
+
+// Extrae la tarea más reciente (solo el propietario)
+static t_tape *deque_take(t_deque *deque)
+{
+    t_tape *task;
+    long bottom;
+    long top;
+
+    bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    if (top > bottom) // Deque vacía
+    {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return (NULL);
+    }
+    task = atomic_load_explicit(&deque->tasks[bottom & (POOL_DEQUE_SIZE - 1)], memory_order_relaxed);
+    if (top == bottom) // Última tarea: se compite con los ladrones
+    {
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                memory_order_seq_cst, memory_order_relaxed))
+            task = NULL;
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return (task);
+}
+
+// Roba la tarea más antigua de otra deque (NULL si está vacía o se pierde la carrera)
+static t_tape *deque_steal(t_deque *deque)
+{
+    t_tape *task;
+    long bottom;
+    long top;
+
+    top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (top >= bottom)
+        return (NULL);
+    task = atomic_load_explicit(&deque->tasks[top & (POOL_DEQUE_SIZE - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+            memory_order_seq_cst, memory_order_relaxed))
+        return (NULL);
+    return (task);
+}
+
+// Número aproximado de tareas de una deque
+static long deque_size(t_deque *deque)
+{
+    long size;
+
+    size = atomic_load_explicit(&deque->bottom, memory_order_acquire)
+        - atomic_load_explicit(&deque->top, memory_order_acquire);
+    return (size > 0 ? size : 0);
+}
+
+// Despierta hasta count trabajadores ociosos
+static void pool_wake(t_pool *pool, int count)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&pool->idle, memory_order_relaxed) > 0)
+    {
+        atomic_fetch_add_explicit(&pool->epoch, 1, memory_order_release);
+        futex_wake(&pool->epoch, count);
+    }
+}
+
+// Pasa a la deque del trabajador una parte proporcional de la cola de inyección
+static t_tape *pool_grab(t_worker *worker)
+{
+    t_pool *pool;
+    t_tape *task;
+    int count;
+    int head;
+    int len;
+
+    pool = worker->pool;
+    if (atomic_load_explicit(&pool->inject_head, memory_order_relaxed)
+        == atomic_load_explicit(&pool->inject_len, memory_order_relaxed)) // Sin mutex: solo es una pista
+        return (NULL);
+    task = NULL;
+    safe_mutex(&pool->inject_mtx, LOCK);
+    head = atomic_load_explicit(&pool->inject_head, memory_order_relaxed);
+    len = atomic_load_explicit(&pool->inject_len, memory_order_relaxed);
+    count = (len - head) / pool->n_workers + 1;
+    if (count > POOL_DEQUE_SIZE - deque_size(&worker->deque) - 1)
+        count = POOL_DEQUE_SIZE - deque_size(&worker->deque) - 1;
+    if (head < len && count > 0)
+    {
+        task = pool->inject[head++];
+        while (--count > 0 && head < len)
+            deque_push(&worker->deque, pool->inject[head++]);
+        atomic_store_explicit(&pool->inject_head, head, memory_order_relaxed);
+    }
+    safe_mutex(&pool->inject_mtx, UNLOCK);
+    if (task && deque_size(&worker->deque) > 0)
+        pool_wake(pool, 1); // Hay trabajo sobrante que otros pueden robar
+    return (task);
+}
+
+// Busca una tarea: deque propia, cola de inyección y, por último, robo a otros trabajadores
+static t_tape *pool_find(t_worker *worker)
+{
+    t_pool *pool;
+    t_tape *task;
+    int start;
+    int i;
+
+    pool = worker->pool;
+    if ((task = deque_take(&worker->deque)) || (task = pool_grab(worker)))
+        return (task);
+    start = rand_r(&worker->seed) % pool->n_workers;
+    for (i = 0; i < pool->n_workers; i++)
+    {
+        t_worker *victim = &pool->workers[(start + i) % pool->n_workers];
+
+        if (victim != worker && (task = deque_steal(&victim->deque)))
+            return (task);
+    }
+    return (NULL);
+}
+
+// Indica si queda alguna tarea visible para un trabajador ocioso
+static bool pool_has_work(t_pool *pool)
+{
+    int i;
+
+    if (atomic_load_explicit(&pool->inject_head, memory_order_relaxed)
+        != atomic_load_explicit(&pool->inject_len, memory_order_relaxed))
+        return (true);
+    for (i = 0; i < pool->n_workers; i++)
+        if (deque_size(&pool->workers[i].deque) > 0)
+            return (true);
+    return (false);
+}
+
+// Duerme al trabajador hasta que haya nuevas tareas o se detenga el pool y, si tiene cintas
+// apartadas, como mucho hasta que la primera vuelva a tener fichas
+static void pool_sleep(t_worker *worker)
+{
+    t_pool *pool;
+    unsigned epoch;
+    uint64_t now;
+
+    pool = worker->pool;
+    epoch = atomic_load_explicit(&pool->epoch, memory_order_acquire);
+    atomic_fetch_add_explicit(&pool->idle, 1, memory_order_seq_cst);
+    if (!pool_has_work(pool) && !atomic_load_explicit(&pool->stop, memory_order_acquire))
+    {
+        if (!worker->later)
+            futex_wait(&pool->epoch, epoch);
+        else if ((now = log_clock()) < worker->later_min)
+            futex_timedwait(&pool->epoch, epoch, worker->later_min - now);
+    }
+    atomic_fetch_sub_explicit(&pool->idle, 1, memory_order_relaxed);
+}
+
+// Aparta una cinta sin fichas hasta su not_before_ns: el trabajador sigue con otras cintas
+static void pool_defer(t_worker *worker, t_tape *task)
+{
+    if (!worker->later || task->not_before_ns < worker->later_min)
+        worker->later_min = task->not_before_ns;
+    task->later = worker->later;
+    worker->later = task;
+}
+
+// Devuelve a la deque las cintas apartadas que ya tienen fichas
+static void pool_due(t_worker *worker)
+{
+    t_tape **link;
+    t_tape *task;
+    uint64_t now;
+    long size;
+
+    if (!worker->later || (now = log_clock()) < worker->later_min)
+        return ;
+    worker->later_min = UINT64_MAX;
+    for (link = &worker->later, size = 0; (task = *link);)
+    {
+        if (task->not_before_ns <= now)
+        {
+            *link = task->later;
+            size = deque_push(&worker->deque, task);
+            continue ;
+        }
+        if (task->not_before_ns < worker->later_min)
+            worker->later_min = task->not_before_ns;
+        link = &task->later;
+    }
+    if (size > 1)
+        pool_wake(worker->pool, 1); // Hay trabajo sobrante que otros pueden robar
+}
+
+// Ejecuta un turno de la cinta y la devuelve a la deque o la da por terminada
+static void pool_run_task(t_worker *worker, t_tape *task)
+{
+    t_pool *pool;
+
+    pool = worker->pool;
+    if (worker->items_len < task->factory->batch_size)
+    {
+        worker->items_len = task->factory->batch_size;
+        free(worker->items);
+        worker->items = safe_malloc(worker->items_len * sizeof(t_element), false);
+    }
+    // Una cinta de más prioridad mueve más elementos en cada turno: recibe más tiempo de los trabajadores
+    if (!belt_step(task, worker->items, POOL_QUANTUM * (1 + task->priority)))
+    {
+        if (task->not_before_ns) // Sin fichas: se aparta en lugar de ocupar la deque
+            pool_defer(worker, task);
+        // Solo se despierta a otro trabajador si queda más de una tarea que repartir
+        else if (deque_push(&worker->deque, task) > 1)
+            pool_wake(pool, 1);
+    }
+    else if (atomic_fetch_sub_explicit(&pool->remaining, 1, memory_order_acq_rel) == 1)
+        futex_wake(&pool->remaining, INT_MAX); // Última cinta de la ejecución
+}
+
+// Bucle de cada hilo trabajador
+static void *pool_worker(void *arg)
+{
+    t_worker *worker;
+    t_tape *task;
+
+    worker = (t_worker *)arg;
+    while (!atomic_load_explicit(&worker->pool->stop, memory_order_acquire))
+    {
+        pool_due(worker);
+        if ((task = pool_find(worker)))
+            pool_run_task(worker, task);
+        else
+            pool_sleep(worker); // Sin tareas, o todas las suyas apartadas por falta de fichas
+    }
+    free(worker->items);
+    return (NULL);
+}
+
+// Crea un pool con n_workers hilos (0 para usar tantos como núcleos en línea)
+t_pool *pool_create(int n_workers)
+{
+    t_pool *pool;
+    int i;
+
+    if (n_workers <= 0 && (n_workers = sysconf(_SC_NPROCESSORS_ONLN)) <= 0)
+        n_workers = 1;
+    if (posix_memalign((void **)&pool, CACHE_LINE, sizeof(t_pool)))
+        err_free_exit(NULL, "[ERROR][pool] Memory allocation failed.");
+    memset(pool, 0, sizeof(t_pool));
+    pool->n_workers = n_workers;
+    if (posix_memalign((void **)&pool->workers, CACHE_LINE, n_workers * sizeof(t_worker)))
+        err_free_exit(NULL, "[ERROR][pool] Memory allocation failed.");
+    memset(pool->workers, 0, n_workers * sizeof(t_worker));
+    safe_mutex(&pool->inject_mtx, INIT);
+    for (i = 0; i < n_workers; i++)
+    {
+        pool->workers[i].pool = pool;
+        pool->workers[i].seed = i + 1;
+        safe_thread(&pool->workers[i].thread, pool_worker, &pool->workers[i], NULL, CREATE);
+    }
+    return (pool);
+}
+
+// Ejecuta todas las cintas de la fábrica en el pool y espera a que terminen
+void pool_run(t_pool *pool, t_factory *factory)
+{
+    int first[PRIORITY_MAX + 2];
+    unsigned remaining;
+    int heads;
+    int i;
+
+    if (!factory->n_tapes)
+        return ;
+    safe_mutex(&pool->inject_mtx, LOCK);
+    pool->inject = safe_malloc(factory->n_tapes * sizeof(t_tape *), false);
+    // Las cintas de más prioridad se reparten primero, con una ordenación por recuento estable sobre
+    // los PRIORITY_MAX + 1 niveles: first[p] es la posición de la primera cinta de prioridad p
+    memset(first, 0, sizeof(first));
+    for (i = 0; i < factory->n_tapes; i++)
+        if (!factory->tapes[i].upstream) // Un pipeline es una sola tarea: solo se reparte su primera cinta
+            first[PRIORITY_MAX - factory->tapes[i].priority + 1]++;
+    for (i = 1; i <= PRIORITY_MAX + 1; i++)
+        first[i] += first[i - 1];
+    heads = first[PRIORITY_MAX + 1];
+    for (i = 0; i < factory->n_tapes; i++)
+        if (!factory->tapes[i].upstream)
+            pool->inject[first[PRIORITY_MAX - factory->tapes[i].priority]++] = &factory->tapes[i];
+    atomic_store_explicit(&pool->inject_head, 0, memory_order_relaxed);
+    atomic_store_explicit(&pool->remaining, heads, memory_order_relaxed);
+    atomic_store_explicit(&pool->inject_len, heads, memory_order_relaxed);
+    safe_mutex(&pool->inject_mtx, UNLOCK);
+    pool_wake(pool, pool->n_workers);
+
+    while ((remaining = atomic_load_explicit(&pool->remaining, memory_order_acquire)))
+        futex_wait(&pool->remaining, remaining);
+
+    safe_mutex(&pool->inject_mtx, LOCK);
+    free(pool->inject);
+    pool->inject = NULL;
+    atomic_store_explicit(&pool->inject_head, 0, memory_order_relaxed);
+    atomic_store_explicit(&pool->inject_len, 0, memory_order_relaxed);
+    safe_mutex(&pool->inject_mtx, UNLOCK);
+}
+
+// Detiene los trabajadores y libera el pool
+void pool_destroy(t_pool *pool)
+{
+    int i;
+
+    if (!pool)
+        return ;
+    atomic_store_explicit(&pool->stop, true, memory_order_release);
+    atomic_fetch_add_explicit(&pool->epoch, 1, memory_order_release);
+    futex_wake(&pool->epoch, INT_MAX);
+    for (i = 0; i < pool->n_workers; i++)
+        safe_thread(&pool->workers[i].thread, NULL, NULL, NULL, JOIN);
+    safe_mutex(&pool->inject_mtx, DESTROY);
+    free(pool->workers);
+    free(pool);
+}
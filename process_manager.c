@@ -1,47 +1,299 @@
 #include "queue.h"
+#include <errno.h>
+#include <time.h>
 
-// Función que ejecutará el hilo productor
-static void *producer(void *arg)
+// Tamaño de lote efectivo de una cinta: nunca mayor que su capacidad (la mínima si es adaptable)
+int belt_batch(t_tape *queue)
 {
-    t_tape *queue;
-    t_element item;
-    int i;
+    if (queue->factory->batch_size < queue->size_min)
+        return (queue->factory->batch_size);
+    return (queue->size_min);
+}
 
-    queue = (t_tape *)arg; // Castea el argumento a un puntero de tipo t_tape
-    for (i = 0; i < queue->num_elements; i++) // Itera para producir el número de elementos especificado
+// Cinta adaptable (atributo "resize="; el productor la llama con queue_mtx tras cada lote). Cada
+// ADAPT_WINDOW lotes decide la capacidad con las esperas de la ventana: si el productor esperó con la
+// cinta llena en más de la cuarta parte de los lotes, la duplica; si no esperó nunca y el consumidor
+// esperó elementos en más de la mitad, la reduce a la mitad sin dejar fuera lo que hay en cola
+static void belt_adapt(t_tape *queue, bool waited)
+{
+    int capacity;
+
+    queue->adapt_ops++;
+    queue->adapt_full += waited;
+    if (queue->adapt_ops < ADAPT_WINDOW)
+        return ;
+    capacity = queue->max_size;
+    if (queue->adapt_full * 4 > queue->adapt_ops)
+        capacity = capacity * 2 < queue->size_max ? capacity * 2 : queue->size_max;
+    else if (!queue->adapt_full && queue->adapt_empty * 2 > queue->adapt_ops)
+    {
+        capacity = capacity / 2 > queue->size_min ? capacity / 2 : queue->size_min;
+        capacity = capacity > queue->size ? capacity : queue->size;
+    }
+    if (capacity != queue->max_size)
+        queue_resize(queue, capacity);
+    queue->adapt_ops = 0;
+    queue->adapt_full = 0;
+    queue->adapt_empty = 0;
+}
+
+// Publica n elementos en una cinta SPSC: no toma queue_mtx, solo espera si el anillo está lleno
+static void spsc_push(t_tape *queue, t_element *items, int n)
+{
+    int done;
+    int put;
+    uint64_t ts;
+
+    for (done = 0; done < n; done += put)
+    {
+        queue_spsc_wait_put(queue); // La espera va antes de la marca de tiempo: el registro no se retrasa
+        ts = log_stamp(); // Antes de publicar, para que preceda a la marca del consumidor
+        put = queue_spsc_put_batch(queue, items + done, n - done);
+        log_elements(LOG_INTRODUCED, items + done, put, ts);
+    }
+}
+
+// Genera n elementos en una cinta SPSC construyéndolos en su sitio del anillo, sin pasar por el lote
+// local: no hay copia. Se registran desde el anillo tras publicarlos, porque solo este productor
+// vuelve a escribir en esas posiciones
+static void spsc_produce(t_tape *queue, int n)
+{
+    t_element *slots;
+    int done;
+    int put;
+    uint64_t ts;
+
+    for (done = 0; done < n; done += put)
+    {
+        put = n - done;
+        slots = queue_spsc_reserve(queue, &put); // La espera va antes de la marca de tiempo
+        ts = log_stamp(); // Antes de publicar, para que preceda a la marca del consumidor
+        queue_spsc_commit(queue, put);
+        log_elements(LOG_INTRODUCED, slots, put, ts);
+    }
+}
+
+// Publica n elementos ya repartidos con queue_mpmc_claim en una cinta MPMC sin bloquearse; solo
+// espera, sin marca de tiempo pendiente, cuando la cinta está llena
+static void mpmc_push(t_tape *queue, t_element *items, int n)
+{
+    int done;
+    int put;
+    uint64_t ts;
+
+    for (done = 0; done < n; done += put)
+    {
+        ts = log_stamp(); // Antes de publicar, para que preceda a la marca del consumidor
+        put = queue_mpmc_put_batch(queue, items + done, n - done);
+        log_elements(LOG_INTRODUCED, items + done, put, ts);
+        if (done + put < n)
+            queue_mpmc_wait_put(queue);
+    }
+}
+
+// Marcas de ocupación efectivas de una cinta mutex (con queue_mtx, la capacidad puede cambiar). Sin
+// "wake=", el consumidor espera la cinta llena y el productor sale en cuanto queda un hueco
+static inline int belt_high(t_tape *queue)
+{
+    return (queue->wake_high && queue->wake_high < queue->max_size ? queue->wake_high : queue->max_size);
+}
+
+static inline int belt_low(t_tape *queue)
+{
+    return (queue->wake_low && queue->wake_low < queue->max_size ? queue->wake_low : queue->max_size);
+}
+
+// Adelanta un plazo absoluto us microsegundos
+static inline void deadline_add(struct timespec *deadline, int us)
+{
+    deadline->tv_sec += us / 1000000;
+    deadline->tv_nsec += (long)(us % 1000000) * 1000;
+    if (deadline->tv_nsec >= 1000000000)
+    {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+
+// Espera del consumidor de una cinta mutex hasta la marca alta o el final de la producción. Con
+// "timeout=" también vuelve si vence el plazo y hay algo que obtener; si la cinta sigue vacía, el
+// plazo se renueva
+static void mutex_wait_items(t_tape *queue)
+{
+    struct timespec deadline;
+    int ret;
+
+    if (queue->wait_us)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline_add(&deadline, queue->wait_us);
+    }
+    while (queue->size < belt_high(queue) && !queue->finished)
+    {
+        if (!queue->wait_us)
+        {
+            safe_cond(&queue->not_empty, &queue->queue_mtx, WAIT);
+            continue ;
+        }
+        ret = pthread_cond_timedwait(&queue->not_empty, &queue->queue_mtx, &deadline);
+        if (ret && ret != ETIMEDOUT)
+            err_free_exit(NULL, "[ERROR][factory_manager] Condition variable operation failed.");
+        if (ret == ETIMEDOUT && queue->size) // Plazo vencido: el consumidor se lleva lo que haya
+            break ;
+        if (ret == ETIMEDOUT)
+            deadline_add(&deadline, queue->wait_us);
+    }
+}
+
+// Publica n elementos en una cinta en modo mutex: un lote por cada toma de queue_mtx
+static void mutex_push(t_tape *queue, t_element *items, int n)
+{
+    bool waited;
+    int done;
+    int put;
+    uint64_t ts;
+    uint64_t start;
+
+    for (done = 0; done < n; done += put)
     {
         safe_mutex(&queue->queue_mtx, LOCK); // Bloquea el mutex de la cola
-        while (queue->size == queue->max_size) // Si la cola está llena, espera
-            safe_cond(&queue->not_full, &queue->queue_mtx, WAIT);
+        waited = (queue->size == queue->max_size);
+        if (waited) // Si la cola está llena, espera
+        {
+            start = stats_clock();
+            while (queue->size >= belt_low(queue)) // Con "wake=", hasta bajar de la marca baja
+                safe_cond(&queue->not_full, &queue->queue_mtx, WAIT);
+            STATS_WAITED(queue, full_wait, start); // Solo se cuentan las esperas reales
+        }
 
-        queue_put(queue, &item); // Inserta un elemento en la cola
-        printf("[OK][queue] Introduced element with id %d in belt %d.\n", item.num_edition, item.id_belt);
+        put = queue_put_batch(queue, items + done, n - done); // Inserta un lote de elementos en la cola
+        if (queue->size_min < queue->size_max)
+            belt_adapt(queue, waited);
+        ts = log_stamp(); // La marca se toma con el mutex para conservar el orden respecto al consumidor
 
-        safe_cond(&queue->not_empty, &queue->queue_mtx, SIGNAL); // Señaliza al consumidor que hay un nuevo elemento disponible
+        if (!queue->wake_high || queue->size >= belt_high(queue)) // Con "wake=", solo al llegar a la marca alta
+            safe_cond(&queue->not_empty, &queue->queue_mtx, SIGNAL); // Una única señal por lote al consumidor
 
         safe_mutex(&queue->queue_mtx, UNLOCK); // Desbloquea el mutex de la cola
+        log_elements(LOG_INTRODUCED, items + done, put, ts); // Se registra fuera de la sección crítica
     }
+}
 
+// Marca una cinta en modo mutex como terminada para que su consumidor vacíe lo que quede y salga
+static void mutex_close(t_tape *queue)
+{
     safe_mutex(&queue->queue_mtx, LOCK); // Bloquea el mutex para marcar la cola como terminada
     queue->finished = true; // Indica que la producción ha terminado
     safe_cond(&queue->not_empty, &queue->queue_mtx, SIGNAL); // Señaliza al consumidor que puede terminar
     safe_mutex(&queue->queue_mtx, UNLOCK); // Desbloquea el mutex
+}
 
-    return (NULL); // Retorna NULL al finalizar
+// Publica n elementos en la cinta según su modo. En una cinta MPMC reparte antes sus ediciones
+static void belt_push(t_tape *queue, t_element *items, int n)
+{
+    if (queue->impl == QUEUE_SPSC)
+        spsc_push(queue, items, n);
+    else if (queue->impl == QUEUE_MPMC)
+        mpmc_push(queue, items, queue_mpmc_claim(queue, items, n));
+    else
+        mutex_push(queue, items, n);
 }
 
-// Función que ejecutará el hilo consumidor
-static void *consumer(void *arg)
+// Procesa un lote obtenido: ejecuta la etapa de la cinta y lo pasa a la siguiente del pipeline
+static inline void belt_forward(t_tape *queue, t_element *items, int n)
 {
-    t_tape *queue;
-    t_element *item;
+    if (queue->stage)
+        queue->stage->fn(items, n, queue->stage->arg);
+    if (queue->next)
+        belt_push(queue->next, items, n);
+}
+
+// Productor de una cinta que genera sus elementos: lotes de hasta batch elementos
+static void belt_producer(t_tape *queue, t_element *items, int batch)
+{
+    int produced;
+    int count;
+
+    if (queue->impl == QUEUE_MPMC) // Los productores se reparten los números de edición
+    {
+        while ((count = queue_mpmc_claim(queue, items, batch)))
+        {
+            rate_take(queue, count, true); // Con "rate=", el cubo de fichas lo comparten los productores
+            mpmc_push(queue, items, count);
+        }
+        return ;
+    }
+    // Itera hasta producir el número de elementos especificado (al reanudar, desde el punto de control)
+    for (produced = queue->num_created; produced < queue->num_elements; produced += count)
+    {
+        count = queue->num_elements - produced; // Nunca se producen más elementos de los pedidos
+        if (count > batch)
+            count = batch;
+        rate_take(queue, count, true); // Con "rate=", espera las fichas del lote
+        if (queue->impl == QUEUE_SPSC)
+            spsc_produce(queue, count);
+        else
+            mutex_push(queue, items, count);
+    }
+    if (queue->impl == QUEUE_MUTEX)
+        mutex_close(queue);
+}
+
+// Consumidor de una cinta SPSC: termina al obtener el elemento marcado como último
+static void spsc_consumer(t_tape *queue, t_element *items, int batch)
+{
+    bool last;
+    int count;
+
+    last = (queue->ckpt_base == queue->num_elements); // Reanudada con todo ya obtenido
+    while (!last)
+    {
+        count = queue_spsc_get_batch(queue, items, batch);
+        // Ocupación antes de obtener: lo obtenido más lo que el consumidor aún ve disponible
+        stats_obtained(queue, items, count,
+            count + (int)(queue->tail_cache - atomic_load_explicit(&queue->ring_head, memory_order_relaxed)));
+        log_elements(LOG_OBTAINED, items, count, log_stamp());
+        sink_elements(items, count); // Salida binaria (opciones -o y -O)
+        last = items[count - 1].last;
+        belt_forward(queue, items, count); // Tras el registro: no se bloquea con una marca pendiente
+    }
+}
+
+// Consumidor de una cinta MPMC: termina cuando entre todos los consumidores se han obtenido
+// num_elements elementos (el marcado como último no tiene por qué ser el último en salir)
+static void mpmc_consumer(t_tape *queue, t_element *items, int batch)
+{
+    int count;
+
+    while ((count = queue_mpmc_get_batch(queue, items, batch)))
+    {
+        stats_obtained(queue, items, count, count + (int)(atomic_load_explicit(&queue->enq_pos, memory_order_relaxed)
+            - atomic_load_explicit(&queue->deq_pos, memory_order_relaxed)));
+        log_elements(LOG_OBTAINED, items, count, log_stamp());
+        sink_elements(items, count);
+        belt_forward(queue, items, count);
+    }
+}
+
+// Bucle del consumidor en modo mutex: extrae lotes de hasta batch elementos por cada toma de queue_mtx
+static void mutex_consumer(t_tape *queue, t_element *items, int batch)
+{
+    int count;
+    uint64_t ts;
+    uint64_t start;
 
-    queue = (t_tape *)arg; // Castea el argumento a un puntero de tipo t_tape
     while (true) // Bucle infinito hasta que se cumpla la condición de salida
     {
         safe_mutex(&queue->queue_mtx, LOCK); // Bloquea el mutex de la cola
-        while (queue->size < queue->max_size && !queue->finished) // Espera si la cola está vacía y no ha terminado
-            safe_cond(&queue->not_empty, &queue->queue_mtx, WAIT);
+        // Espera si la cola no está llena y no ha terminado; con "wake=" vacía la cinta antes de volver
+        // a esperar la marca alta
+        if (!queue->finished && (queue->wake_high ? !queue->size : queue->size < queue->max_size))
+        {
+            start = stats_clock();
+            mutex_wait_items(queue);
+            STATS_WAITED(queue, empty_wait, start);
+            queue->adapt_empty++;
+        }
 
         // Salir si ya no habrá más producción y la cola está vacía
         if (queue->finished && !queue->size)
@@ -50,53 +302,184 @@ static void *consumer(void *arg)
             break;
         }
 
-        item = queue_get(queue); // Obtiene un elemento de la cola
-        printf("[OK][queue] Obtained element with id %d in belt %d.\n", item->num_edition, item->id_belt);
+        count = queue_get_batch(queue, items, batch); // Obtiene un lote de elementos de la cola
+        ts = log_stamp();
+        stats_obtained(queue, items, count, count + queue->size); // Ocupación antes de obtener el lote
 
-        safe_cond(&queue->not_full, &queue->queue_mtx, SIGNAL); // Avisa al producer si estaba bloqueado
+        if (!queue->wake_low || queue->size < belt_low(queue)) // Con "wake=", solo por debajo de la marca baja
+            safe_cond(&queue->not_full, &queue->queue_mtx, SIGNAL); // Avisa al producer si estaba bloqueado
         safe_mutex(&queue->queue_mtx, UNLOCK);
+        log_elements(LOG_OBTAINED, items, count, ts); // Se registra fuera de la sección crítica
+        sink_elements(items, count);
+        belt_forward(queue, items, count); // Fuera de la sección crítica: la cinta siguiente puede estar llena
+    }
+}
+
+// Roba un lote de victim, una cinta mutex del grupo, como lo obtendría su consumidor: con queue_mtx,
+// avisando al productor y registrando los elementos como de victim. thieves la mantiene viva hasta
+// que el lote está registrado: su process_manager no informa de la cinta antes. Devuelve los robados
+static int steal_batch(t_tape *victim, t_element *items, int batch)
+{
+    uint64_t ts;
+    int count;
+
+    atomic_fetch_add_explicit(&victim->thieves, 1, memory_order_relaxed); // queue_mtx lo publica
+    safe_mutex(&victim->queue_mtx, LOCK);
+    count = queue_get_batch(victim, items, batch);
+    ts = log_stamp();
+    if (count)
+        stats_obtained(victim, items, count, count + victim->size);
+    if (count && (!victim->wake_low || victim->size < belt_low(victim)))
+        safe_cond(&victim->not_full, &victim->queue_mtx, SIGNAL);
+    safe_mutex(&victim->queue_mtx, UNLOCK);
+    log_elements(LOG_OBTAINED, items, count, ts);
+    sink_elements(items, count);
+    belt_forward(victim, items, count); // Etapa de victim (las cintas de un grupo no tienen siguiente)
+    atomic_fetch_sub_explicit(&victim->thieves, 1, memory_order_release);
+    return (count);
+}
+
+// Consumidor ocioso de una cinta con "group=": cuando su cinta ha terminado roba lotes de la cinta
+// más llena del grupo hasta que todas terminan. Solo se roba de cintas mutex sin "order=strict",
+// porque su cola admite varios consumidores con queue_mtx; el orden de sus elementos entre el
+// consumidor propio y los ladrones deja de estar garantizado. No se espera en las condiciones de la
+// cinta (la señal podría no llegar a su consumidor): sin nada que robar hay pausas crecientes. Con -f
+// solo se roba dentro del grupo de procesos: el mutex de una cinta de otro proceso quedaría tomado
+// si ese proceso muere a mitad del robo, y el fallo de una cinta no saldría de su proceso
+static void belt_steal(t_tape *queue, t_element *items, int batch)
+{
+    struct timespec pause;
+    t_tape *victim;
+    t_tape *t;
+    long idle_ns;
+    bool active;
+    int first;
+    int last;
+    int best;
+    int size;
+    int i;
+
+    first = 0; // Cintas entre las que se busca víctima: todas o, con -f, las del mismo proceso
+    last = queue->factory->n_tapes;
+    if (queue->factory->fork_group)
+    {
+        first = (queue - queue->factory->tapes) / queue->factory->fork_group * queue->factory->fork_group;
+        last = first + queue->factory->fork_group < last ? first + queue->factory->fork_group : last;
     }
+    idle_ns = STEAL_IDLE_NS;
+    while (true)
+    {
+        victim = NULL;
+        best = 0;
+        active = false;
+        for (i = first; i < last; i++)
+        {
+            t = &queue->factory->tapes[i];
+            if (t == queue || t->group != queue->group || t->ordered || t->impl != QUEUE_MUTEX || t->status)
+                continue ;
+            size = __atomic_load_n(&t->size, __ATOMIC_RELAXED); // Solo orienta: se comprueba con queue_mtx
+            active |= size || !__atomic_load_n(&t->finished, __ATOMIC_RELAXED);
+            if (size > best)
+            {
+                best = size;
+                victim = t;
+            }
+        }
+        if (!active) // Todas las hermanas han terminado y están vacías
+            return ;
+        if (victim && steal_batch(victim, items, batch))
+        {
+            idle_ns = STEAL_IDLE_NS;
+            continue ;
+        }
+        pause.tv_sec = 0;
+        pause.tv_nsec = idle_ns;
+        nanosleep(&pause, NULL);
+        idle_ns = idle_ns * 2 < STEAL_IDLE_MAX_NS ? idle_ns * 2 : STEAL_IDLE_MAX_NS;
+    }
+}
+
+// Arranque de un productor o consumidor: toma uno de los lotes locales que la arena reservó para su
+// cinta y, si la cinta tiene CPU asignadas, se fija a la que corresponde a su posición
+static t_element *thread_batch(t_tape *queue, int batch)
+{
+    int slot;
 
+    slot = atomic_fetch_add_explicit(&queue->batch_slot, 1, memory_order_relaxed);
+    affinity_thread(queue, slot);
+    priority_thread(queue); // Con "priority=", las cintas menos prioritarias ceden la CPU
+    return (queue->batches + (size_t)slot * batch);
+}
+
+// Función que ejecutará el hilo productor
+static void *producer(void *arg)
+{
+    t_tape *queue;
+    t_element *items;
+    int batch;
+
+    queue = (t_tape *)arg; // Castea el argumento a un puntero de tipo t_tape
+    batch = belt_batch(queue);
+    items = thread_batch(queue, batch); // Lote local del productor
+    belt_producer(queue, items, batch);
+    return (NULL); // Retorna NULL al finalizar
+}
+
+// Función que ejecutará el hilo consumidor
+static void *consumer(void *arg)
+{
+    t_tape *queue;
+    t_element *items;
+    int batch;
+
+    queue = (t_tape *)arg; // Castea el argumento a un puntero de tipo t_tape
+    batch = belt_batch(queue);
+    items = thread_batch(queue, batch); // Lote local del consumidor
+    if (queue->impl == QUEUE_SPSC)
+        spsc_consumer(queue, items, batch);
+    else if (queue->impl == QUEUE_MPMC)
+        mpmc_consumer(queue, items, batch);
+    else
+        mutex_consumer(queue, items, batch);
+    if (queue->group) // Ayuda a las cintas de su grupo que aún tienen trabajo
+        belt_steal(queue, items, batch);
+    sink_flush(); // Lo que quede en el bloque de salida del consumidor
+    // El último consumidor que alimenta la cinta siguiente la cierra (en modo mutex su consumidor
+    // espera a que se llene o a que termine la producción)
+    if (queue->next && atomic_fetch_sub_explicit(&queue->next->feeders, 1, memory_order_acq_rel) == 1
+        && queue->next->impl == QUEUE_MUTEX)
+        mutex_close(queue->next);
     return (NULL);
 }
 
-// Función para sincronizar los procesos en el que se emplea una doble barrera, la primera para esperar a que todos los procesos estén listos
-// y la segunda para que todos los procesos estén esperando a que la fábrica esté lista para empezar
-// Se emplea una condición y un semáforo para la primera barrera y una doble condición para la segunda barrera (empleando un broadcast activado de desde factory_manager)
+// Función para sincronizar los procesos en dos fases sobre la barrera de la fábrica: la primera espera a que
+// todas las cintas estén listas y la segunda a que todas hayan anunciado que esperan para empezar a la vez
 static void	synchro(t_tape *queue, bool flag)
 {
-    safe_mutex(&queue->factory->mtx, LOCK); // Bloquea el mutex de la fábrica
-    queue->factory->ready_tapes++; // Incrementa el contador de cintas listas
-    if (queue->factory->ready_tapes == queue->factory->n_tapes) // Si todas las cintas están listas
-        safe_cond(&queue->factory->ready_threads, NULL, SIGNAL); // Señaliza a la fábrica que todos los procesos están listos
-    safe_mutex(&queue->factory->mtx, UNLOCK); // Desbloquea el mutex
-    safe_sem(&queue->factory->sem, 0, WAIT); // Espera a que el resto de procesos estén listos
+    int id;
+
+    id = queue->barrier_id; // Fija su hoja en el árbol de la barrera
+    barrier_wait(&queue->factory->barrier, id); // Espera a que el resto de procesos estén listos
 
     if (flag) // Si el flag está activado, imprime un mensaje informativo
-        printf("[OK][process_manager] Process_manager with id %d waiting to produce %d elements.\n", queue->id, queue->num_elements);
+        log_msg(LOG_TAPE_WAITING, queue->id, queue->num_elements);
 
-    safe_mutex(&queue->factory->mtx, LOCK); // Bloquea el mutex de la fábrica
-    queue->factory->waiting_tapes++; // Incrementa el contador de cintas esperando
-    if (queue->factory->waiting_tapes == queue->factory->n_tapes) // Si todas las cintas están esperando
-        safe_cond(&queue->factory->waiting_threads, NULL, SIGNAL); // Señaliza a la fábrica que todas las cintas están esperando
-    safe_mutex(&queue->factory->mtx, UNLOCK); // Desbloquea el mutex
-    safe_mutex(&queue->factory->mtx, LOCK); // Bloquea el mutex nuevamente
-    safe_cond(&queue->factory->broadcast, &queue->factory->mtx, WAIT); // Espera a que la fábrica esté lista para empezar
-    safe_mutex(&queue->factory->mtx, UNLOCK); // Desbloquea el mutex
+    barrier_wait(&queue->factory->barrier, id); // Espera a que la fábrica esté lista para empezar
 }
 
 // Función principal que gestiona el proceso de una cinta
 void *process_manager (void *arg)
 {
-    pthread_t threads[NUM_THREADS]; // Arreglo de hilos para productor y consumidor
+    pthread_t *threads; // Productores seguidos de consumidores
     t_tape *queue;
     int *status;
-    int ret;
+    int n_producers;
+    int i;
 
-    status = safe_malloc(sizeof(int), false); // Asigna memoria para el estado del hilo
+    queue = (t_tape *)arg;
+    status = &queue->status; // El estado del hilo se guarda en la propia cinta
     *status = 0; // Inicializa el estado como exitoso
 
-    queue = (t_tape *)arg;
 	// Aunque ya hayamos comprobado estas condiciones al hacer el parseo, lo implementamos
     // para verificar que el fallo de un hilo no interrumpe la ejecución del resto
     if (queue->num_elements <= 0 || queue->max_size <= 0)
@@ -106,34 +489,207 @@ void *process_manager (void *arg)
         return (fprintf(stderr, "[ERROR][process_manager] Arguments not valid.\n"), status);
     }
 
+    // La cola se inicializa antes de la barrera: en un pipeline, los consumidores de la cinta
+    // anterior pueden empezar a pasarle elementos en cuanto se cruza
+    affinity_thread(queue, -1); // Con colocación, el buffer se toca por primera vez desde su nodo
+    affinity_touch(queue);
+    *status = queue_init(queue, queue->max_size); // Inicializa la cola
+    if (!*status)
+        checkpoint_restore(queue); // Con -r, continúa desde el último punto de control
     synchro(queue, true); // Sincroniza el proceso exitoso
 
-    if (queue_init(queue, queue->max_size) == -1) // Inicializa la cola
-    {
-        *status = -1; // Marca el estado como error
+    if (*status == -1)
         return (fprintf(stderr, "[ERROR][process_manager] There was an error executing process_manager with id %d\n", queue->id), status);
+    log_msg(LOG_BELT_CREATED, queue->id, queue->max_size);
+
+    // Crea los hilos productores y consumidores (uno de cada salvo en modo MPMC). Una cinta de un
+    // pipeline no tiene productores propios: producen en ella los consumidores de la cinta anterior
+    queue->run_start_ns = log_clock();
+    n_producers = queue->upstream ? 0 : queue->producers;
+    threads = queue->threads; // Tabla de hilos y lotes reservados en la arena
+    atomic_store_explicit(&queue->batch_slot, 0, memory_order_relaxed);
+    for (i = 0; i < n_producers + queue->consumers; i++)
+        safe_thread(&threads[i], i < n_producers ? producer : consumer, queue, NULL, CREATE);
+
+    // Espera a que terminen todos los hilos de la cinta
+    for (i = 0; i < n_producers + queue->consumers; i++)
+    {
+        if (pthread_join(threads[i], NULL))
+        {
+            *status = -1; // Marca el estado como error
+            return (fprintf(stderr, "[ERROR][process_manager] There was an error executing process_manager with id %d\n", queue->id), status);
+        }
     }
-    printf("[OK][process_manager] Belt with id %d has been created with a maximum of %d elements.\n", queue->id, queue->max_size);
+    // Lotes que otras cintas del grupo le han robado y aún registran: la cinta termina después
+    while (atomic_load_explicit(&queue->thieves, memory_order_acquire))
+        sched_yield();
+    queue->run_end_ns = log_clock();
+    if (queue->impl == QUEUE_MPMC) // Los productores reparten las ediciones: se cuentan las publicadas
+        queue->num_created = atomic_load_explicit(&queue->enq_pos, memory_order_relaxed);
+
+    queue_destroy(queue); // Destruye la cola
+    log_msg(LOG_TAPE_PRODUCED, queue->id, queue->num_created);
+
+    return (status); // Retorna el estado del proceso
+}
 
-    // Crea los hilos productor y consumidor
-    safe_thread(&threads[0], producer, queue, NULL, CREATE);
-    safe_thread(&threads[1], consumer, queue, NULL, CREATE);
+// Turno cooperativo de una cinta dentro del pool de hilos: alterna lotes de productor y consumidor
+// sin bloquearse hasta mover quantum elementos o hasta que no pueda avanzar. Solo un trabajador
+// ejecuta la cinta a la vez, así que la cola se usa sin queue_mtx. Un pipeline es una sola tarea:
+// queue es su primera cinta y cada lote obtenido pasa a la siguiente solo si cabe entero.
+// Devuelve true al terminar todas las cintas; si no, not_before_ns indica si espera fichas
+bool belt_step(t_tape *queue, t_element *items, int quantum)
+{
+    t_tape *t;
+    uint64_t ts;
+    bool pending;
+    int batch;
+    int moved;
+    int put;
+    int got;
+    int n;
 
-    // Espera a que el hilo productor termine
-    if ((ret = pthread_join(threads[0], NULL)))
+    for (t = queue->elements ? NULL : queue; t; t = t->next) // Primer turno: se crean las cintas
     {
-        *status = -1; // Marca el estado como error
-        return (fprintf(stderr, "[ERROR][process_manager] There was an error executing process_manager with id %d\n", queue->id), status);
+        if (queue_init(t, t->max_size) == -1)
+        {
+            queue->status = -1;
+            fprintf(stderr, "[ERROR][process_manager] There was an error executing process_manager with id %d\n", t->id);
+            return (true);
+        }
+        log_msg(LOG_BELT_CREATED, t->id, t->max_size);
+        t->run_start_ns = log_clock();
     }
-    // Espera a que el hilo consumidor termine
-    if ((ret = pthread_join(threads[1], NULL)))
+    batch = belt_batch(queue);
+    for (moved = 0; moved < quantum; moved += put + got)
     {
-        *status = -1; // Marca el estado como error
-        return (fprintf(stderr, "[ERROR][process_manager] There was an error executing process_manager with id %d\n", queue->id), status);
+        put = queue->num_elements - queue->num_created; // Elementos que quedan por producir
+        put = put < batch ? put : batch;
+        put = put < queue->max_size - queue->size ? put : queue->max_size - queue->size;
+        put = queue_put_batch(queue, items, rate_take(queue, put, false)); // Sin esperar las fichas
+        ts = log_stamp();
+        log_elements(LOG_INTRODUCED, items, put, ts);
+        for (t = queue, got = 0; t; t = t->next)
+        {
+            n = belt_batch(t);
+            if (t->next && t->next->max_size - t->next->size < n) // Lo obtenido debe caber en la siguiente
+                n = t->next->max_size - t->next->size;
+            n = queue_get_batch(t, items, n);
+            stats_obtained(t, items, n, n + t->size);
+            log_elements(LOG_OBTAINED, items, n, log_stamp());
+            sink_elements(items, n);
+            belt_forward(t, items, n);
+            got += n;
+        }
+        if (!put && !got)
+            break;
     }
+    queue->not_before_ns = 0;
+    if (!moved && queue->num_created < queue->num_elements) // Cinta limitada sin fichas: el pool la aparta
+        queue->not_before_ns = rate_ready(queue);
+    for (t = queue, pending = queue->num_created < queue->num_elements; t && !pending; t = t->next)
+        pending = t->size > 0;
+    if (pending)
+        return (false);
+    for (t = queue; t; t = t->next)
+    {
+        t->run_end_ns = log_clock();
+        queue_destroy(t);
+        log_msg(LOG_TAPE_PRODUCED, t->id, t->num_created);
+    }
+    sink_flush(); // El trabajador pasa a otra cinta
+    return (true);
+}
 
-    queue_destroy(queue); // Destruye la cola
-    printf("[OK][process_manager] Process_manager with id %d has produced %d elements.\n", queue->id, queue->num_created);
+// Indica si una cinta se ejecuta en línea (solo en el modo con hilos): una cinta mutex pequeña
+// (num_elements * max_size < INLINE_THRESHOLD), sin pipeline, grupo, prioridad (su valor nice es
+// por hilo), límite de ritmo, capacidad adaptable, marcas, plazo ni CPU propias, y sin puntos de
+// control (que copian la cinta con queue_mtx)
+bool belt_inline(const t_tape *queue)
+{
+    return (!queue->factory->pool && !queue->factory->fork_group
+        && queue->mode == QUEUE_MUTEX && queue->num_elements > 0 && queue->max_size > 0
+        && (long)queue->num_elements * queue->max_size < INLINE_THRESHOLD && !queue->upstream && !queue->next
+        && !queue->group && !queue->priority && !queue->rate && !queue->pinned && queue->size_min == queue->size_max
+        && !queue->wake_high && !queue->wait_us
+        && !queue->factory->checkpoint.base);
+}
 
-    return (status); // Retorna el estado del proceso
+// Obtiene un lote de una cinta en línea y lo procesa como el consumidor del modo mutex
+static int inline_get(t_tape *queue, t_element *items, int batch)
+{
+    int n;
+
+    n = queue_get_batch(queue, items, batch);
+    stats_obtained(queue, items, n, n + queue->size);
+    log_elements(LOG_OBTAINED, items, n, log_stamp());
+    sink_elements(items, n);
+    belt_forward(queue, items, n);
+    return (n);
+}
+
+// Cinta en línea: el mismo hilo sigue, sin queue_mtx, el único orden posible entre el productor y el
+// consumidor del modo mutex: el productor llena la cinta, el consumidor (que espera la cinta llena)
+// obtiene un lote y se repite hasta terminar la producción; después el consumidor la vacía
+static void inline_belt(t_tape *queue, t_element *items)
+{
+    int batch;
+    int n;
+
+    batch = belt_batch(queue);
+    while (true)
+    {
+        while (queue->size < queue->max_size && queue->num_created < queue->num_elements)
+        {
+            n = queue->num_elements - queue->num_created < batch ? queue->num_elements - queue->num_created : batch;
+            n = queue_put_batch(queue, items, n);
+            log_elements(LOG_INTRODUCED, items, n, log_stamp());
+        }
+        if (queue->num_created == queue->num_elements) // Producción terminada
+            break ;
+        inline_get(queue, items, batch); // Cinta llena: un lote
+    }
+    while (inline_get(queue, items, batch))
+        ;
+}
+
+// Hilo que ejecuta un grupo de cintas pequeñas en lugar de un process_manager, un productor y un
+// consumidor por cinta. Cruza la barrera de arranque una sola vez por fase en nombre de todas y
+// emite, cinta a cinta, los mismos mensajes que process_manager
+void *inline_runner(void *arg)
+{
+    t_inline_run *run;
+    t_barrier *barrier;
+    t_element *items;
+    t_tape *queue;
+    int i;
+
+    run = (t_inline_run *)arg;
+    barrier = &run->tapes[0]->factory->barrier;
+    // Un solo lote local para todas sus cintas: la arena no les reserva hilos ni lotes
+    items = safe_malloc(run->tapes[0]->factory->batch_size * sizeof(t_element), false);
+    for (i = 0; i < run->n_tapes; i++) // Colas creadas antes de la barrera, como en process_manager
+        run->tapes[i]->status = queue_init(run->tapes[i], run->tapes[i]->max_size);
+    barrier_wait(barrier, run->barrier_id);
+    for (i = 0; i < run->n_tapes; i++)
+        log_msg(LOG_TAPE_WAITING, run->tapes[i]->id, run->tapes[i]->num_elements);
+    barrier_wait(barrier, run->barrier_id);
+    for (i = 0; i < run->n_tapes; i++)
+    {
+        queue = run->tapes[i];
+        if (queue->status == -1)
+        {
+            fprintf(stderr, "[ERROR][process_manager] There was an error executing process_manager with id %d\n", queue->id);
+            continue ;
+        }
+        log_msg(LOG_BELT_CREATED, queue->id, queue->max_size);
+        queue->run_start_ns = log_clock();
+        inline_belt(queue, items);
+        queue->run_end_ns = log_clock();
+        queue_destroy(queue);
+        log_msg(LOG_TAPE_PRODUCED, queue->id, queue->num_created);
+    }
+    free(items);
+    sink_flush();
+    return (NULL);
 }
@@ -1,4 +1,5 @@
 #include "queue.h"
+#include <sys/mman.h>
 
 // Función para imprimir el estado de la cola (comentada)
 /*
@@ -21,22 +22,184 @@ void print_queue(t_tape *queue)
 }
 */
 
-// Inicializar la cola circular
+// Posiciones del anillo SPSC: la capacidad redondeada a potencia de dos para indexar con máscara
+static unsigned spsc_ring_size(int capacity)
+{
+    unsigned size;
+
+    size = 1;
+    while (size < (unsigned)capacity) // Redondea la capacidad a la siguiente potencia de dos
+        size <<= 1;
+    return (size);
+}
+
+// Instanciaciones del anillo de elementos de las cintas, una por capacidad de RING_CAPACITIES
+#define RING_BELT(cap) RING_DEFINE(belt##cap, t_element, cap)
+RING_CAPACITIES(RING_BELT)
+#undef RING_BELT
+
+// Elige la instanciación del anillo de la cinta según sus posiciones: las del anillo SPSC o la
+// capacidad de los modos mutex y MPMC. Se llama al preparar la cola y al cambiar su capacidad
+void queue_ring(t_tape *queue)
+{
+    unsigned size;
+
+    size = queue->impl == QUEUE_SPSC ? queue->mask + 1 : (unsigned)queue->max_size;
+    queue->mask = size - 1;
+    queue->ring = (size & (size - 1)) ? RING_MODULO : RING_MASK;
+#define RING_PICK(cap) if (size == cap) queue->ring = RING_CAP_##cap;
+    RING_CAPACITIES(RING_PICK)
+#undef RING_PICK
+}
+
+// Índice del anillo de la cinta que corresponde a la posición pos
+static inline unsigned ring_index(const t_tape *queue, unsigned pos)
+{
+    return (queue->ring == RING_MODULO ? pos % queue->max_size : pos & queue->mask);
+}
+
+// Copia count elementos en el anillo de la cinta a partir de la posición pos (sin envolver) con la
+// instanciación de su clase; sin instanciación, con como mucho dos memcpy
+static inline void ring_write(t_tape *queue, unsigned pos, const t_element *items, unsigned count)
+{
+    unsigned first;
+    unsigned span;
+
+    switch (queue->ring)
+    {
+#define RING_WRITE(cap) case RING_CAP_##cap: belt##cap##_write(queue->elements, pos, items, count); return ;
+        RING_CAPACITIES(RING_WRITE)
+#undef RING_WRITE
+        default:
+            break ;
+    }
+    first = ring_index(queue, pos);
+    span = queue->mask + 1 - first; // Posiciones hasta el final del anillo
+    if (queue->ring == RING_MODULO)
+        span = queue->max_size - first;
+    if (span > count)
+        span = count;
+    memcpy(&queue->elements[first], items, span * sizeof(t_element));
+    memcpy(queue->elements, items + span, (count - span) * sizeof(t_element)); // Parte que da la vuelta
+}
+
+// Copia en items count elementos del anillo de la cinta a partir de la posición pos (sin envolver)
+static inline void ring_read(t_tape *queue, unsigned pos, t_element *items, unsigned count)
+{
+    unsigned first;
+    unsigned span;
+
+    switch (queue->ring)
+    {
+#define RING_READ(cap) case RING_CAP_##cap: belt##cap##_read(queue->elements, pos, items, count); return ;
+        RING_CAPACITIES(RING_READ)
+#undef RING_READ
+        default:
+            break ;
+    }
+    first = ring_index(queue, pos);
+    span = queue->mask + 1 - first; // Posiciones hasta el final del anillo
+    if (queue->ring == RING_MODULO)
+        span = queue->max_size - first;
+    if (span > count)
+        span = count;
+    memcpy(items, &queue->elements[first], span * sizeof(t_element));
+    memcpy(items + span, queue->elements, (count - span) * sizeof(t_element)); // Parte que da la vuelta
+}
+
+// Prepara el anillo SPSC sobre el buffer de la cinta
+static int spsc_init(t_tape *queue, int capacity)
+{
+    if (capacity > SPSC_MAX_CAPACITY)
+        return (-1);
+    queue->mask = spsc_ring_size(capacity) - 1;
+    atomic_init(&queue->ring_tail, 0);
+    atomic_init(&queue->ring_head, 0);
+    atomic_init(&queue->cons_waiting, 0);
+    atomic_init(&queue->prod_waiting, 0);
+    queue->head_cache = 0;
+    queue->tail_cache = 0;
+    queue->prod_spin = SPSC_SPIN_MIN;
+    queue->cons_spin = SPSC_SPIN_MIN;
+    queue->elements = queue->buffer;
+    return (0);
+}
+
+// Prepara el anillo MPMC sobre el buffer de la cinta: cada celda empieza libre para el productor de su misma posición. Los turnos
+// se codifican como 2 * pos (libre) y 2 * pos + 1 (ocupada), de modo que una cinta de capacidad 1 no
+// confunde la celda recién publicada con la celda libre de la vuelta siguiente.
+// Las posiciones no llegan a dar la vuelta (nunca pasan de num_elements + capacidad), así que la
+// capacidad no necesita ser potencia de dos y se respeta exactamente
+static int mpmc_init(t_tape *queue, int capacity)
+{
+    int i;
+
+    queue->cells = queue->buffer;
+    for (i = 0; i < capacity; i++)
+        atomic_init(&queue->cells[i].seq, 2 * i);
+    atomic_init(&queue->enq_pos, 0);
+    atomic_init(&queue->next_edition, 0);
+    atomic_init(&queue->put_epoch, 0);
+    atomic_init(&queue->cons_sleepers, 0);
+    atomic_init(&queue->deq_pos, 0);
+    atomic_init(&queue->get_epoch, 0);
+    atomic_init(&queue->prod_sleepers, 0);
+    return (0);
+}
+
+// Bytes del buffer de una cola de capacity elementos en su modo (lo reserva la arena de la fábrica)
+size_t queue_buffer_size(const t_tape *queue, int capacity)
+{
+    if (queue->impl == QUEUE_SPSC)
+        return (capacity > SPSC_MAX_CAPACITY ? 0 : spsc_ring_size(capacity) * sizeof(t_element));
+    if (queue->impl == QUEUE_MPMC)
+        return ((size_t)capacity * sizeof(t_mpmc_cell));
+    return ((size_t)capacity * sizeof(t_element));
+}
+
+// Inicializar la cola circular sobre el buffer que la arena reservó para la cinta
 int queue_init(t_tape *queue, int capacity)
 {
-    // Asignar memoria para los elementos de la cola
-    queue->elements = calloc(capacity, sizeof(t_element));
-    if (!queue->elements) // Verificar si la asignación de memoria falló
+    if (!queue->buffer // La arena no ha repartido la memoria de la cinta
+        || (queue->impl == QUEUE_SPSC && spsc_init(queue, capacity) == -1) // Índices libres y máscara
+        || (queue->impl == QUEUE_MPMC && mpmc_init(queue, capacity) == -1)) // Celdas con secuencia
     {
         fprintf(stderr, "[ERROR][queue] There was an error while using queue with id: %d\n", queue->id);
-        return (-1); // Retornar error
+        return (-1);
     }
+    if (queue->impl == QUEUE_MUTEX)
+        queue->elements = queue->buffer; // Elementos de la cola
+    queue_ring(queue); // Instanciación del anillo según la capacidad
     queue->head = 0; // Inicializar el índice de la cabeza
     queue->tail = -1; // Inicializar el índice de la cola
     queue->size = 0; // Inicializar el tamaño de la cola
+    queue->num_created = 0; // La cinta puede ejecutarse más de una vez (modo servicio)
+    queue->ckpt_base = 0; // checkpoint_restore lo cambia al reanudar
+    queue->finished = false;
+    queue->reserved = 0;
+    queue->peeked = 0;
+    queue->adapt_ops = 0; // Primera ventana de la cinta adaptable
+    queue->adapt_full = 0;
+    queue->adapt_empty = 0;
+    queue->resizes = 0;
+    atomic_store_explicit(&queue->rate_tat, 0, memory_order_relaxed); // Cubo de fichas lleno
+    stats_init(queue); // Reinicia la instrumentación de la cinta (solo con FACTORY_STATS)
     return (0); // Éxito
 }
 
+// Asigna a un elemento su cinta, su número de edición y la marca de último
+static inline void stamp_element(t_tape *queue, t_element *x)
+{
+    x->id_belt = queue->id;
+    x->num_edition = queue->num_created++;
+    x->last = (queue->num_created == queue->num_elements);
+    if (!queue->upstream) // Primera cinta del pipeline: el dato inicial es la edición
+        x->payload = x->num_edition;
+#ifdef FACTORY_STATS
+    x->ts = log_clock();
+#endif
+}
+
 // Insertar un elemento en la cola
 int queue_put(t_tape *queue, t_element *x)
 {
@@ -44,24 +207,17 @@ int queue_put(t_tape *queue, t_element *x)
         return (-1); // Retornar error si la cola está llena
 
     queue->size++; // Incrementar el tamaño de la cola
-    x->id_belt = queue->id; // Asignar el id de la cinta al elemento
-    x->num_edition = queue->num_created; // Asignar el número de edición al elemento
-    queue->num_created++; // Incrementar el contador de elementos creados
-
-    // Marcar el elemento como el último si es el último que se debe producir
-    if (queue->num_created == queue->num_elements)
-        x->last = true;
-    else
-        x->last = false;
+    stamp_element(queue, x); // Asignar cinta, número de edición y marca de último al elemento
 
     // Avanzar el índice de la cola de forma circular
-    queue->tail = (queue->tail + 1) % queue->max_size;
+    queue->tail = ring_index(queue, queue->tail + 1);
     queue->elements[queue->tail] = *x; // Copiar el elemento en la cola
     // print_queue(queue); // (Comentado) Imprimir el estado de la cola
     return (0); // Éxito
 }
 
-// Eliminar un elemento de la cola
+// Eliminar un elemento de la cola. El puntero señala la posición liberada: solo es válido mientras
+// se mantenga queue_mtx (para usar el elemento en su sitio, queue_peek y queue_release)
 t_element *queue_get(t_tape *queue)
 {
     t_element *item;
@@ -71,12 +227,162 @@ t_element *queue_get(t_tape *queue)
 
     item = &queue->elements[queue->head]; // Obtener el elemento en la cabeza de la cola
     // Avanzar el índice de la cabeza de forma circular
-    queue->head = (queue->head + 1) % queue->max_size;
+    queue->head = ring_index(queue, queue->head + 1);
     queue->size--; // Decrementar el tamaño de la cola
     // print_queue(queue); // (Comentado) Imprimir el estado de la cola
     return (item); // Retornar el elemento eliminado
 }
 
+// Insertar hasta n elementos consecutivos en la cola (el llamante mantiene queue_mtx)
+// Copia el lote con la instanciación del anillo de la cinta y devuelve cuántos ha insertado
+int queue_put_batch(t_tape *queue, t_element *items, int n)
+{
+    int count;
+    int i;
+
+    count = queue->max_size - queue->size; // Huecos libres
+    if (n < count)
+        count = n;
+    if (count <= 0)
+        return (0);
+    for (i = 0; i < count; i++)
+        stamp_element(queue, &items[i]);
+    ring_write(queue, queue->tail + 1, items, count); // A partir de la primera posición libre
+    queue->tail = ring_index(queue, queue->tail + count);
+    queue->size += count;
+    return (count);
+}
+
+// Extraer hasta max elementos de la cola copiándolos en items (el llamante mantiene queue_mtx)
+// Devuelve el número de elementos extraídos
+int queue_get_batch(t_tape *queue, t_element *items, int max)
+{
+    int count;
+
+    count = queue->size;
+    if (max < count)
+        count = max;
+    if (count <= 0)
+        return (0);
+    ring_read(queue, queue->head, items, count);
+    queue->head = ring_index(queue, queue->head + count);
+    queue->size -= count;
+    return (count);
+}
+
+// Reserva en la cola hasta *n posiciones libres y contiguas donde el productor construye los
+// elementos en su sitio; *n pasa a ser las reservadas. Devuelve la primera (NULL si no hay sitio).
+// El llamante mantiene queue_mtx al reservar y al confirmar con queue_commit, no entre ambas: el
+// consumidor no ve las posiciones hasta la confirmación y solo el productor escribe en ellas
+t_element *queue_reserve(t_tape *queue, int *n)
+{
+    int first;
+    int count;
+
+    first = ring_index(queue, queue->tail + 1);
+    count = queue->max_size - queue->size; // Huecos libres
+    if (count > queue->max_size - first) // Solo el tramo contiguo hasta el final del buffer
+        count = queue->max_size - first;
+    if (*n < count)
+        count = *n;
+    *n = count > 0 ? count : 0;
+    queue->reserved = *n;
+    return (*n ? &queue->elements[first] : NULL);
+}
+
+// Publica los n primeros elementos reservados con queue_reserve (el llamante mantiene queue_mtx):
+// les asigna cinta, edición y marca de último sin copiarlos. Devuelve cuántos ha publicado
+int queue_commit(t_tape *queue, int n)
+{
+    t_element *items;
+    int i;
+
+    if (n > queue->reserved)
+        n = queue->reserved;
+    items = &queue->elements[ring_index(queue, queue->tail + 1)];
+    for (i = 0; i < n; i++)
+        stamp_element(queue, &items[i]);
+    queue->tail = ring_index(queue, queue->tail + n);
+    queue->size += n;
+    queue->reserved = 0;
+    return (n);
+}
+
+// Devuelve hasta *n elementos contiguos de la cabeza de la cola sin sacarlos, para procesarlos en
+// su sitio; *n pasa a ser los obtenidos (NULL si la cola está vacía). El llamante mantiene
+// queue_mtx al mirar y al liberar con queue_release, no entre ambas: las posiciones siguen
+// ocupadas, así que el productor no las reutiliza
+t_element *queue_peek(t_tape *queue, int *n)
+{
+    int count;
+
+    count = queue->size;
+    if (count > queue->max_size - queue->head) // Solo el tramo contiguo hasta el final del buffer
+        count = queue->max_size - queue->head;
+    if (*n < count)
+        count = *n;
+    *n = count > 0 ? count : 0;
+    queue->peeked = *n;
+    return (*n ? &queue->elements[queue->head] : NULL);
+}
+
+// Saca de la cola los n primeros elementos devueltos por queue_peek y libera sus posiciones (el
+// llamante mantiene queue_mtx)
+void queue_release(t_tape *queue, int n)
+{
+    if (n > queue->peeked)
+        n = queue->peeked;
+    queue->head = ring_index(queue, queue->head + n);
+    queue->size -= n;
+    queue->peeked = 0;
+}
+
+// Cambia la capacidad de una cola en modo mutex (el llamante mantiene queue_mtx). El buffer ya tiene
+// sitio para size_max elementos, así que no se reserva nada: solo se mueve el tramo que no quedaría
+// contiguo. Al crecer se mueve el más corto de los dos tramos de una cola que da la vuelta (como mucho
+// la mitad de los elementos en cola); al reducir, como mucho los elementos en cola. Las páginas
+// completas que quedan fuera de la nueva capacidad se devuelven al sistema.
+// Devuelve -1 si la capacidad está fuera de los límites, los elementos en cola no caben o hay
+// posiciones reservadas o en uso en su sitio (se moverían bajo el productor o el consumidor)
+int queue_resize(t_tape *queue, int capacity)
+{
+    uintptr_t page;
+    uintptr_t from;
+    uintptr_t to;
+    int old;
+    int front;
+    int wrap;
+
+    old = queue->max_size;
+    if (capacity < queue->size_min || capacity > queue->size_max || capacity < queue->size
+        || queue->reserved || queue->peeked)
+        return (-1);
+    front = old - queue->head; // Elementos en cola desde head hasta el final del buffer
+    wrap = queue->size - front; // Elementos que dan la vuelta al principio (si es positivo)
+    if (wrap > 0 && capacity > old && front > wrap && capacity - old >= wrap)
+        memcpy(&queue->elements[old], queue->elements, wrap * sizeof(t_element)); // El tramo del principio, tras el antiguo final
+    else if (wrap > 0) // El tramo de head, al final de la nueva capacidad
+    {
+        memmove(&queue->elements[capacity - front], &queue->elements[queue->head], front * sizeof(t_element));
+        queue->head = capacity - front;
+    }
+    else if (queue->head >= capacity || queue->head + queue->size > capacity) // Al reducir: al principio
+    {
+        memmove(queue->elements, &queue->elements[queue->head], queue->size * sizeof(t_element));
+        queue->head = 0;
+    }
+    queue->tail = (queue->head + queue->size - 1 + capacity) % capacity;
+    queue->max_size = capacity;
+    queue_ring(queue); // La nueva capacidad puede ser de otra clase
+    queue->resizes++;
+    page = sysconf(_SC_PAGESIZE);
+    from = ((uintptr_t)&queue->elements[capacity] + page - 1) & ~(page - 1);
+    to = (uintptr_t)&queue->elements[old] & ~(page - 1);
+    if (capacity < old && to > from)
+        madvise((void *)from, to - from, MADV_DONTNEED);
+    return (0);
+}
+
 // Verificar si la cola está vacía
 int inline queue_empty(t_tape *queue)
 {
@@ -89,11 +395,400 @@ int inline queue_full(t_tape *queue)
     return (queue->size == queue->max_size); // Retorna verdadero si el tamaño de la cola es igual a su capacidad máxima
 }
 
+// Espera adaptativa del anillo SPSC: gira mientras el índice del otro lado no cambie y,
+// si no avanza en el número de vueltas permitido, duerme en el futex de ese índice.
+// Las vueltas se duplican cuando la espera activa tiene éxito y se reducen a la mitad cuando no
+static unsigned spsc_wait(atomic_uint *index, unsigned old, atomic_uint *waiting, unsigned *spin)
+{
+    unsigned cur;
+    unsigned i;
+
+    for (i = 0; i < *spin; i++)
+    {
+        cur = atomic_load_explicit(index, memory_order_acquire);
+        if (cur != old)
+        {
+            if (*spin < SPSC_SPIN_MAX)
+                *spin <<= 1;
+            return (cur);
+        }
+        cpu_relax();
+    }
+    if (*spin > SPSC_SPIN_MIN)
+        *spin >>= 1;
+    while (true)
+    {
+        // Anuncia que va a dormir antes de volver a comprobar el índice (pareja con spsc_publish)
+        atomic_store_explicit(waiting, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        cur = atomic_load_explicit(index, memory_order_acquire);
+        if (cur != old)
+            break;
+        futex_wait(index, old);
+    }
+    atomic_store_explicit(waiting, 0, memory_order_relaxed);
+    return (cur);
+}
+
+// Publica el nuevo valor de un índice y despierta al otro lado solo si está dormido
+static void spsc_publish(atomic_uint *index, unsigned value, atomic_uint *waiting)
+{
+    atomic_store_explicit(index, value, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiting, memory_order_relaxed))
+        futex_wake(index, 1);
+}
+
+// Espera a que el anillo SPSC tenga al menos un hueco libre
+void queue_spsc_wait_put(t_tape *queue)
+{
+    unsigned tail;
+    uint64_t start;
+
+    tail = atomic_load_explicit(&queue->ring_tail, memory_order_relaxed);
+    // Solo se relee el head compartido cuando la copia local indica que la cinta está llena
+    while (tail - queue->head_cache >= (unsigned)queue->max_size)
+    {
+        queue->head_cache = atomic_load_explicit(&queue->ring_head, memory_order_acquire);
+        if (tail - queue->head_cache >= (unsigned)queue->max_size)
+        {
+            start = stats_clock();
+            queue->head_cache = spsc_wait(&queue->ring_head, queue->head_cache, &queue->prod_waiting, &queue->prod_spin);
+            STATS_WAITED(queue, full_wait, start); // Espera por cinta llena (solo con FACTORY_STATS)
+        }
+    }
+}
+
+// Insertar hasta n elementos en el anillo SPSC, bloqueando solo si está lleno
+// Se publica un único tail por lote, de modo que el consumidor se despierta como mucho una vez
+int queue_spsc_put_batch(t_tape *queue, t_element *items, int n)
+{
+    unsigned tail;
+    unsigned count;
+    int i;
+
+    queue_spsc_wait_put(queue);
+    tail = atomic_load_explicit(&queue->ring_tail, memory_order_relaxed);
+    count = queue->max_size - (tail - queue->head_cache); // Huecos libres
+    if ((unsigned)n < count)
+        count = n;
+    for (i = 0; i < (int)count; i++)
+        stamp_element(queue, &items[i]);
+    ring_write(queue, tail, items, count);
+    spsc_publish(&queue->ring_tail, tail + count, &queue->cons_waiting);
+    return (count);
+}
+
+// Espera a que el anillo SPSC tenga al menos un elemento. Devuelve la posición de lectura
+static unsigned spsc_wait_get(t_tape *queue)
+{
+    unsigned head;
+    uint64_t start;
+
+    head = atomic_load_explicit(&queue->ring_head, memory_order_relaxed);
+    // Solo se relee el tail compartido cuando la copia local indica que la cinta está vacía
+    if (head == queue->tail_cache)
+    {
+        queue->tail_cache = atomic_load_explicit(&queue->ring_tail, memory_order_acquire);
+        if (head == queue->tail_cache)
+        {
+            start = stats_clock();
+            queue->tail_cache = spsc_wait(&queue->ring_tail, head, &queue->cons_waiting, &queue->cons_spin);
+            STATS_WAITED(queue, empty_wait, start); // Espera por cinta vacía (solo con FACTORY_STATS)
+        }
+    }
+    return (head);
+}
+
+// Extraer hasta max elementos del anillo SPSC, bloqueando solo si está vacío
+// Los elementos se copian antes de devolver sus posiciones al productor
+int queue_spsc_get_batch(t_tape *queue, t_element *items, int max)
+{
+    unsigned head;
+    unsigned count;
+
+    head = spsc_wait_get(queue);
+    count = queue->tail_cache - head; // Elementos disponibles
+    if ((unsigned)max < count)
+        count = max;
+    ring_read(queue, head, items, count);
+    spsc_publish(&queue->ring_head, head + count, &queue->prod_waiting);
+    return (count);
+}
+
+// Insertar un elemento en el anillo SPSC, bloqueando solo si está lleno
+int queue_spsc_put(t_tape *queue, t_element *x)
+{
+    queue_spsc_put_batch(queue, x, 1);
+    return (0);
+}
+
+// Extraer una copia del siguiente elemento del anillo SPSC, bloqueando solo si está vacío
+int queue_spsc_get(t_tape *queue, t_element *x)
+{
+    queue_spsc_get_batch(queue, x, 1);
+    return (0);
+}
+
+// Reserva en el anillo SPSC hasta *n posiciones libres y contiguas, bloqueando solo si está lleno,
+// para que el productor construya los elementos en su sitio; *n pasa a ser las reservadas.
+// El consumidor no las ve hasta queue_spsc_commit
+t_element *queue_spsc_reserve(t_tape *queue, int *n)
+{
+    unsigned tail;
+    unsigned first;
+    unsigned count;
+
+    queue_spsc_wait_put(queue);
+    tail = atomic_load_explicit(&queue->ring_tail, memory_order_relaxed);
+    first = tail & queue->mask;
+    count = queue->max_size - (tail - queue->head_cache); // Huecos libres
+    if (count > queue->mask + 1 - first) // Solo el tramo contiguo hasta el final del anillo
+        count = queue->mask + 1 - first;
+    if ((unsigned)*n < count)
+        count = *n;
+    *n = count;
+    return (&queue->elements[first]);
+}
+
+// Publica los n primeros elementos reservados con queue_spsc_reserve sin copiarlos: un único tail
+// para todos, como un lote. Devuelve cuántos ha publicado
+int queue_spsc_commit(t_tape *queue, int n)
+{
+    t_element *items;
+    unsigned tail;
+    int i;
+
+    tail = atomic_load_explicit(&queue->ring_tail, memory_order_relaxed);
+    items = &queue->elements[tail & queue->mask];
+    for (i = 0; i < n; i++)
+        stamp_element(queue, &items[i]);
+    spsc_publish(&queue->ring_tail, tail + n, &queue->cons_waiting);
+    return (n);
+}
+
+// Devuelve hasta *n elementos contiguos del anillo SPSC sin sacarlos, bloqueando solo si está
+// vacío; *n pasa a ser los obtenidos. Sus posiciones no vuelven al productor hasta
+// queue_spsc_release, así que se pueden procesar en su sitio
+t_element *queue_spsc_peek(t_tape *queue, int *n)
+{
+    unsigned head;
+    unsigned first;
+    unsigned count;
+
+    head = spsc_wait_get(queue);
+    first = head & queue->mask;
+    count = queue->tail_cache - head; // Elementos disponibles
+    if (count > queue->mask + 1 - first) // Solo el tramo contiguo hasta el final del anillo
+        count = queue->mask + 1 - first;
+    if ((unsigned)*n < count)
+        count = *n;
+    *n = count;
+    return (&queue->elements[first]);
+}
+
+// Saca del anillo SPSC los n primeros elementos devueltos por queue_spsc_peek y devuelve sus
+// posiciones al productor
+void queue_spsc_release(t_tape *queue, int n)
+{
+    spsc_publish(&queue->ring_head, atomic_load_explicit(&queue->ring_head, memory_order_relaxed) + n,
+        &queue->prod_waiting);
+}
+
+// Reparte hasta n números de edición consecutivos entre los productores de una cinta MPMC y prepara
+// los elementos. Devuelve cuántos se obtienen (0 cuando ya se repartieron todos)
+int queue_mpmc_claim(t_tape *queue, t_element *items, int n)
+{
+    unsigned first;
+    int i;
+
+    first = atomic_fetch_add_explicit(&queue->next_edition, n, memory_order_relaxed);
+    if (first >= (unsigned)queue->num_elements)
+        return (0);
+    if ((unsigned)n > queue->num_elements - first)
+        n = queue->num_elements - first;
+    for (i = 0; i < n; i++)
+    {
+        items[i].id_belt = queue->id;
+        items[i].num_edition = first + i;
+        items[i].last = (first + i == (unsigned)queue->num_elements - 1);
+        if (!queue->upstream)
+            items[i].payload = first + i;
+#ifdef FACTORY_STATS
+        items[i].ts = log_clock();
+#endif
+    }
+    return (n);
+}
+
+// Avisa a los hilos dormidos del otro lado, si los hay, de que la cinta ha cambiado
+static void mpmc_notify(atomic_uint *epoch, atomic_uint *sleepers)
+{
+    atomic_thread_fence(memory_order_seq_cst); // Ordena la publicación de la celda con la lectura de sleepers
+    if (atomic_load_explicit(sleepers, memory_order_relaxed))
+    {
+        atomic_fetch_add_explicit(epoch, 1, memory_order_release);
+        futex_wake(epoch, INT_MAX);
+    }
+}
+
+// Espera a que ready sea cierto: espera activa breve y después futex sobre epoch. El hilo se anuncia
+// en sleepers antes de comprobar ready por última vez, así que no puede perder el aviso
+static void mpmc_wait(t_tape *queue, bool (*ready)(t_tape *), atomic_uint *epoch, atomic_uint *sleepers)
+{
+    unsigned seen;
+    int spin;
+
+    for (spin = 0; spin < MPMC_SPIN; spin++)
+    {
+        if (ready(queue))
+            return ;
+        cpu_relax();
+    }
+    seen = atomic_load_explicit(epoch, memory_order_acquire);
+    atomic_fetch_add_explicit(sleepers, 1, memory_order_seq_cst);
+    if (!ready(queue))
+        futex_wait(epoch, seen);
+    atomic_fetch_sub_explicit(sleepers, 1, memory_order_relaxed);
+}
+
+// Celda de la posición pos del anillo MPMC: con máscara si la capacidad es potencia de dos
+static inline t_mpmc_cell *mpmc_cell(t_tape *queue, unsigned pos)
+{
+    return (&queue->cells[ring_index(queue, pos)]);
+}
+
+// Indica si la celda de la siguiente posición de escritura está libre (o si la posición ya avanzó)
+static bool mpmc_can_put(t_tape *queue)
+{
+    unsigned pos;
+
+    pos = atomic_load_explicit(&queue->enq_pos, memory_order_seq_cst);
+    return ((int)(atomic_load_explicit(&mpmc_cell(queue, pos)->seq, memory_order_seq_cst) - 2 * pos) >= 0);
+}
+
+// Indica si hay un elemento que leer o si ya se obtuvieron todos
+static bool mpmc_can_get(t_tape *queue)
+{
+    unsigned pos;
+
+    pos = atomic_load_explicit(&queue->deq_pos, memory_order_seq_cst);
+    if (pos >= (unsigned)queue->num_elements)
+        return (true);
+    return ((int)(atomic_load_explicit(&mpmc_cell(queue, pos)->seq, memory_order_seq_cst) - (2 * pos + 1)) >= 0);
+}
+
+// Intenta insertar un elemento: false si la celda de la posición actual sigue ocupada (cinta llena)
+static bool mpmc_try_put(t_tape *queue, const t_element *x)
+{
+    t_mpmc_cell *cell;
+    unsigned pos;
+    int dif;
+
+    pos = atomic_load_explicit(&queue->enq_pos, memory_order_relaxed);
+    while (true)
+    {
+        cell = mpmc_cell(queue, pos);
+        dif = (int)(atomic_load_explicit(&cell->seq, memory_order_acquire) - 2 * pos);
+        if (dif < 0) // La celda aún guarda el elemento de la vuelta anterior
+            return (false);
+        if (dif == 0 && atomic_compare_exchange_weak_explicit(&queue->enq_pos, &pos, pos + 1,
+                memory_order_relaxed, memory_order_relaxed))
+            break ;
+        if (dif > 0) // Otro productor ya ocupó la posición
+            pos = atomic_load_explicit(&queue->enq_pos, memory_order_relaxed);
+    }
+    cell->data = *x;
+    atomic_store_explicit(&cell->seq, 2 * pos + 1, memory_order_release); // Lista para el consumidor de pos
+    return (true);
+}
+
+// Intenta extraer un elemento: 1 si lo obtiene, 0 si la cinta está vacía, -1 si ya se obtuvieron todos
+static int mpmc_try_get(t_tape *queue, t_element *x)
+{
+    t_mpmc_cell *cell;
+    unsigned pos;
+    int dif;
+
+    pos = atomic_load_explicit(&queue->deq_pos, memory_order_relaxed);
+    while (true)
+    {
+        if (pos >= (unsigned)queue->num_elements) // deq_pos solo crece: no quedan elementos por obtener
+            return (-1);
+        cell = mpmc_cell(queue, pos);
+        dif = (int)(atomic_load_explicit(&cell->seq, memory_order_acquire) - (2 * pos + 1));
+        if (dif < 0) // El productor de pos aún no ha publicado
+            return (0);
+        if (dif == 0 && atomic_compare_exchange_weak_explicit(&queue->deq_pos, &pos, pos + 1,
+                memory_order_relaxed, memory_order_relaxed))
+            break ;
+        if (dif > 0) // Otro consumidor ya tomó la posición
+            pos = atomic_load_explicit(&queue->deq_pos, memory_order_relaxed);
+    }
+    *x = cell->data;
+    atomic_store_explicit(&cell->seq, 2 * (pos + queue->max_size), memory_order_release); // Libre para la vuelta siguiente
+    return (1);
+}
+
+// Inserta sin bloquearse hasta n elementos en el anillo MPMC. Devuelve cuántos ha insertado
+int queue_mpmc_put_batch(t_tape *queue, t_element *items, int n)
+{
+    int count;
+
+    for (count = 0; count < n && mpmc_try_put(queue, &items[count]); count++)
+        ;
+    if (count)
+        mpmc_notify(&queue->put_epoch, &queue->cons_sleepers);
+    return (count);
+}
+
+// Espera a que el anillo MPMC tenga una celda libre
+void queue_mpmc_wait_put(t_tape *queue)
+{
+    uint64_t start;
+
+    if (mpmc_can_put(queue))
+        return ;
+    start = stats_clock();
+    mpmc_wait(queue, mpmc_can_put, &queue->get_epoch, &queue->prod_sleepers);
+    STATS_WAITED(queue, full_wait, start);
+}
+
+// Extrae hasta max elementos del anillo MPMC, bloqueando solo si está vacío.
+// Devuelve 0 cuando ya se han obtenido todos los elementos de la cinta
+int queue_mpmc_get_batch(t_tape *queue, t_element *items, int max)
+{
+    uint64_t start;
+    int count;
+    int ret;
+
+    count = 0;
+    while (count < max && (ret = mpmc_try_get(queue, &items[count])) >= 0)
+    {
+        if (ret)
+            count++;
+        else if (count) // Se devuelve lo ya obtenido en lugar de esperar
+            break ;
+        else
+        {
+            start = stats_clock();
+            mpmc_wait(queue, mpmc_can_get, &queue->put_epoch, &queue->cons_sleepers);
+            STATS_WAITED(queue, empty_wait, start);
+        }
+    }
+    if (count)
+        mpmc_notify(&queue->get_epoch, &queue->prod_sleepers);
+    // Al obtener el último elemento se despierta al resto de consumidores para que terminen
+    if (atomic_load_explicit(&queue->deq_pos, memory_order_relaxed) >= (unsigned)queue->num_elements)
+        mpmc_notify(&queue->put_epoch, &queue->cons_sleepers);
+    return (count);
+}
+
 // Destruir la cola y liberar los recursos
 int queue_destroy(t_tape *queue)
 {
-    free(queue->elements); // Liberar la memoria asignada para los elementos
-    queue->elements = NULL; // Establecer el puntero a NULL
+    queue->elements = NULL; // La memoria es de la arena: se libera con la fábrica
+    queue->cells = NULL;
     queue->head = 0; // Reiniciar el índice de la cabeza
     queue->tail = -1; // Reiniciar el índice de la cola
     queue->size = 0; // Reiniciar el tamaño de la cola
@@ -1,6 +1,9 @@
 #ifndef HEADER_FILE
 #define HEADER_FILE
 
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE // cpu_set_t y pthread_setaffinity_np
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -9,9 +12,13 @@
 #include <semaphore.h>
 #include <sys/stat.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdatomic.h>
 
 # define BLACK "\033[30m"
 # define RED "\033[31m"
@@ -23,51 +30,396 @@
 # define WHITE "\033[37m"
 # define RESET "\033[0m"
 
-#define NUM_THREADS 2
+#define LOG_BUFFER_RECORDS 1024 // Mensajes que caben en el buffer de registro de cada hilo
+#define LOG_GRACE_NS 1000000ull // Antigüedad mínima de un mensaje antes de volcarlo (1 ms)
+#define LOG_IDLE_NS 200000 // Espera del hilo escritor cuando no hay mensajes (200 us)
+#define LOG_IDLE_MAX_NS 5000000 // Espera máxima del escritor, que se duplica mientras no hay mensajes (5 ms)
+#define LOG_LINE_MAX 128 // Longitud máxima de un mensaje ya formateado
+#define POOL_DEQUE_SIZE 1024 // Tareas que caben en la deque de cada trabajador (potencia de dos)
+#define POOL_QUANTUM 256 // Elementos que mueve una cinta en cada turno del pool
+#define DEFAULT_BATCH 1 // Tamaño de lote por defecto (un elemento por acceso, como el original)
+#define STATS_SAMPLES 65536 // Muestras de latencia que guarda como máximo cada cinta
+#define STATS_BUCKETS 40 // Cubetas log2 del histograma de tiempo en cola (hasta ~9 minutos)
+#define CACHE_LINE 64 // Tamaño de línea de caché asumido para separar índices calientes
+#define SPSC_SPIN_MIN 16 // Vueltas mínimas de espera activa antes de dormir en el futex
+#define SPSC_SPIN_MAX 4096 // Vueltas máximas de espera activa antes de dormir en el futex
+#define SPSC_MAX_CAPACITY (1 << 30) // Capacidad máxima admitida por el anillo sin bloqueos
+#define MPMC_SPIN 64 // Vueltas de espera activa en una cinta MPMC antes de dormir en el futex
+#define BELT_MAX_THREADS 64 // Productores o consumidores como máximo por cinta
+#define STAGE_MAX 32 // Etapas de procesamiento que caben en el registro
+#define STAGE_HASH_ROUNDS 64 // Vueltas de mezcla de la etapa "hash" por elemento
+#define ADAPT_WINDOW 64 // Lotes del productor entre dos decisiones de tamaño de una cinta adaptable
+#define STEAL_IDLE_NS 20000 // Pausa de un consumidor ocioso de un grupo cuando no hay nada que robar (20 us)
+#define STEAL_IDLE_MAX_NS 1000000 // Pausa máxima, que se duplica mientras no hay nada que robar (1 ms)
+#define PRIORITY_MAX 19 // Prioridad máxima de una cinta (atributo "priority="; la diferencia es el valor nice)
+#define RATE_BURST_NS 10000000ull // Ráfaga del cubo de fichas de una cinta limitada (10 ms de elementos)
+#define INLINE_THRESHOLD 4096 // Cintas con num_elements * max_size por debajo se ejecutan en línea, sin hilos propios
+#define INLINE_BELTS 64 // Cintas en línea que se reparten como mínimo a cada hilo que las ejecuta
+#define BARRIER_FANIN 4 // Hilos o nodos que comparten cada nodo de la barrera de arranque
+#define BARRIER_SPIN 128 // Vueltas de espera activa en la barrera antes de dormir en el futex
+#define ARENA_HUGE_PAGE (2u << 20) // A partir de este tamaño la arena intenta usar páginas enormes
+#define CHECKPOINT_MS 100 // Intervalo entre dos puntos de control de la fábrica (opción -c)
+#define CHECKPOINT_RETRIES 8 // Intentos de copiar una cinta SPSC cuyo consumidor adelanta a la copia
+#define METRICS_MS 1000 // Intervalo por defecto entre dos muestras de las métricas (opción -m)
+#define SINK_CHUNK (256u << 10) // Bytes de registros que cada consumidor junta antes de encolarlos para escribir
+#define SINK_FREE_CHUNKS 64 // Bloques ya escritos que se conservan para reutilizar
+#define SINK_MAGIC "FACTSNK1" // Comienzo de los ficheros de salida (opciones -o y -O)
+#define DAEMON_BACKLOG 16 // Conexiones pendientes en el socket del modo servicio
+#define DAEMON_MAX_JOB (64u << 20) // Tamaño máximo de la definición de un trabajo del modo servicio
+#define DAEMON_TIMEOUT_MS 5000 // Plazo de cada lectura y escritura con un cliente del modo servicio
+
+// Pausa de la CPU dentro de los bucles de espera activa
+#if defined(__x86_64__) || defined(__i386__)
+# define cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+# define cpu_relax() __asm__ __volatile__("yield")
+#else
+# define cpu_relax() __asm__ __volatile__("" ::: "memory")
+#endif
+
+// Anillos tipados. RING_DEFINE(name, type, cap) genera un anillo de elementos type con capacidad cap
+// fija al compilar (potencia de dos): el índice es una máscara constante y cada copia tiene el tamaño
+// del tipo, así que el compilador puede desenrollar los lotes y los datos no pasan por void *.
+// name##_write/name##_read copian un lote a partir de una posición libre (sin envolver) sobre un
+// buffer externo, como el de una cinta en la arena; t_##name lleva además su propio buffer y
+// posiciones, con name##_push/name##_pop para un único hilo (o con el cierre del llamante)
+#define RING_DEFINE(name, type, cap) \
+_Static_assert((cap) > 0 && ((cap) & ((cap) - 1)) == 0, #name ": the capacity must be a power of two"); \
+typedef struct s_##name \
+{ \
+	unsigned head; \
+	unsigned tail; \
+	type slots[cap]; \
+} t_##name; \
+static inline void name##_write(type *slots, unsigned pos, const type *items, unsigned count) \
+{ \
+	unsigned first = pos & ((cap) - 1); \
+	unsigned span = (cap) - first < count ? (cap) - first : count; \
+	unsigned i; \
+	for (i = 0; i < span; i++) \
+		slots[first + i] = items[i]; \
+	for (; i < count; i++) \
+		slots[i - span] = items[i]; \
+} \
+static inline void name##_read(const type *slots, unsigned pos, type *items, unsigned count) \
+{ \
+	unsigned first = pos & ((cap) - 1); \
+	unsigned span = (cap) - first < count ? (cap) - first : count; \
+	unsigned i; \
+	for (i = 0; i < span; i++) \
+		items[i] = slots[first + i]; \
+	for (; i < count; i++) \
+		items[i] = slots[i - span]; \
+} \
+static inline int name##_push(t_##name *ring, const type *items, int n) \
+{ \
+	unsigned count = (cap) - (ring->tail - ring->head); \
+	if ((unsigned)n < count) \
+		count = n; \
+	name##_write(ring->slots, ring->tail, items, count); \
+	ring->tail += count; \
+	return (count); \
+} \
+static inline int name##_pop(t_##name *ring, type *items, int max) \
+{ \
+	unsigned count = ring->tail - ring->head; \
+	if ((unsigned)max < count) \
+		count = max; \
+	name##_read(ring->slots, ring->head, items, count); \
+	ring->head += count; \
+	return (count); \
+}
+
+// Capacidades con instanciación propia para las cintas (X(cap) por cada una). El resto de potencias
+// de dos usa la máscara en marcha y, en el modo mutex, las demás capacidades el módulo
+#define RING_CAPACITIES(X) X(1) X(2) X(4) X(8) X(16) X(32) X(64) X(128) X(256) X(512) X(1024) X(2048) X(4096)
 
 // Se explica el por qué de las estructuras empleadas en la memoria de la práctica
 
 typedef struct s_factory t_factory;
+typedef struct s_pool t_pool;
+typedef struct s_barrier_node t_barrier_node;
+
+// Barrera reutilizable de árbol combinado para el arranque de las cintas
+typedef struct s_barrier
+{
+	int participants;
+	t_barrier_node *nodes; // Hojas primero y la raíz al final
+} t_barrier;
+
+// Arena de la fábrica: una sola proyección de la que se reparten, alineados a línea de caché, los
+// buffers de las cintas, los lotes y los hilos de cada cinta y los nodos de la barrera
+typedef struct s_arena
+{
+	char *base; // Proyección (NULL mientras solo se calcula el tamaño)
+	size_t size; // Bytes proyectados
+	size_t used; // Bytes repartidos
+	bool huge; // Respaldada por páginas enormes (MAP_HUGETLB)
+} t_arena;
+
+// Fichero de puntos de control de la fábrica, proyectado en memoria
+typedef struct s_checkpoint
+{
+	char *base; // Proyección compartida del fichero (NULL: sin puntos de control)
+	size_t size;
+	bool resume; // Las cintas continúan desde su última copia (opción -r)
+	bool stop; // La fábrica ha terminado (con mtx)
+	pthread_t thread; // Hilo que copia las cintas cada CHECKPOINT_MS
+	pthread_mutex_t mtx;
+	pthread_cond_t wake; // Despierta al hilo al terminar la fábrica
+} t_checkpoint;
+
+// Fichero de métricas de la fábrica en marcha, en formato de texto de Prometheus (opción -m)
+typedef struct s_metrics
+{
+	const char *path; // Destino (NULL: sin métricas)
+	char *tmp; // Fichero que se escribe y después se renombra sobre path
+	int interval_ms; // Intervalo entre dos muestras
+	bool stop; // La fábrica ha terminado (con mtx)
+	uint64_t start_ns; // Arranque de las cintas
+	pthread_t thread; // Hilo que escribe una muestra cada interval_ms
+	pthread_mutex_t mtx;
+	pthread_cond_t wake; // Despierta al hilo al terminar la fábrica
+} t_metrics;
 
 typedef struct s_element
 {
 	int num_edition;
 	int id_belt;
 	int last;
+	int64_t payload; // Dato que transforman las etapas del pipeline (la primera cinta pone num_edition)
+#ifdef FACTORY_STATS
+	uint64_t ts; // Instante en que el elemento entró en la cinta (ns)
+#endif
 } t_element;
 
+// Cabecera de un fichero de salida (opciones -o y -O)
+typedef struct s_sink_header
+{
+	char magic[8]; // SINK_MAGIC
+	uint32_t record_size; // sizeof(t_sink_record) del ejecutable que lo escribió
+	uint32_t reserved;
+} t_sink_header;
+
+// Registro de un elemento obtenido en un fichero de salida, sin relleno (9 bytes)
+typedef struct __attribute__((packed)) s_sink_record
+{
+	int32_t num_edition;
+	int32_t id_belt;
+	uint8_t last;
+} t_sink_record;
+
+// Etapa de procesamiento: la ejecutan los consumidores de una cinta sobre cada lote obtenido, antes
+// de pasarlo a la cinta siguiente del pipeline. Con varios consumidores se llama de forma concurrente
+typedef void (*t_stage_fn)(t_element *items, int n, void *arg);
+
+typedef struct s_stage
+{
+	const char *name; // Nombre del atributo "stage=" del fichero de entrada
+	t_stage_fn fn;
+	void *arg;
+} t_stage;
+
+#ifdef FACTORY_STATS
+// Esperas de un lado de la cinta (productor por cinta llena o consumidor por falta de elementos)
+typedef struct s_wait_stats
+{
+	uint64_t count; // Veces que tuvo que esperar
+	uint64_t ns; // Tiempo total esperando
+} t_wait_stats;
+#endif
+
+// Implementación de la cola que usa cada cinta (atributo "mode=" del fichero de entrada)
+typedef enum e_queue_mode
+{
+	QUEUE_MUTEX, // Cola circular protegida por queue_mtx y variables de condición
+	QUEUE_SPSC, // Anillo sin bloqueos de un productor y un consumidor
+	QUEUE_MPMC, // Anillo de Vyukov con números de secuencia: varios productores y consumidores
+} t_queue_mode;
+
+// Clase del anillo de una cinta según su capacidad: con qué instanciación de RING_DEFINE se copia
+#define RING_CLASS(cap) RING_CAP_##cap,
+typedef enum e_ring_class
+{
+	RING_MODULO, // Capacidad que no es potencia de dos (solo modo mutex): índices con módulo
+	RING_MASK, // Potencia de dos sin instanciación propia: máscara en marcha
+	RING_CAPACITIES(RING_CLASS) // Instanciación con la capacidad constante
+} t_ring_class;
+#undef RING_CLASS
+
+// Colocación de los hilos de las cintas en las CPU (opción -a)
+typedef enum e_affinity
+{
+	AFFINITY_NONE, // El sistema decide (original)
+	AFFINITY_COMPACT, // Cada cinta en CPU consecutivas, llenando los nodos uno tras otro
+	AFFINITY_SCATTER, // Cada cinta en CPU consecutivas de un nodo, repartiendo las cintas entre nodos
+} t_affinity;
+
+// Celda del anillo MPMC: seq indica de quién es el turno (seq == 2 * pos: libre para el productor de
+// la posición pos; seq == 2 * pos + 1: lista para el consumidor de pos)
+typedef struct s_mpmc_cell
+{
+	atomic_uint seq;
+	t_element data;
+} t_mpmc_cell;
+
+// Cinta: la configuración, que no cambia durante la ejecución, va separada de las partes que
+// escriben el productor y el consumidor, cada una en sus propias líneas de caché. El tamaño de la
+// estructura es múltiplo de CACHE_LINE y el array de cintas se reserva alineado, de modo que
+// cintas vecinas tampoco comparten líneas
 typedef struct s_tape
 {
+	// Configuración (solo lectura mientras la cinta está en marcha)
 	int id;
-	int max_size; //capacity
-	int size; //size
+	int max_size; //capacity (en una cinta adaptable cambia en marcha, siempre con queue_mtx)
+	int size_min; // Límites de la capacidad (atributo "resize="; iguales a max_size si no se adapta)
+	int size_max;
+	int wake_low; // Marcas de ocupación del modo mutex (atributo "wake="; 0: sin marcas, cinta llena)
+	int wake_high;
+	int wait_us; // Espera máxima del consumidor por la marca alta (atributo "timeout="; 0: sin límite)
 	int num_elements;
-	int num_created;
-	int head;
-	int tail;
-	bool finished;
+	t_queue_mode mode; // Modo pedido en la configuración ("mode=" o resuelto por el analizador)
+	t_queue_mode impl; // Cola que la implementa en esta ejecución: mode o, en el pool, la circular (factory_layout)
+	int status; // Resultado de la cinta (0 o -1); process_manager devuelve su dirección
+	int barrier_id; // Participante de la barrera de arranque que la representa
+	unsigned mask; // Modos SPSC y mutex: posiciones del anillo (potencia de dos) menos uno
+	t_ring_class ring; // Instanciación del anillo que copia los lotes (queue_ring)
+	int producers; // Hilos productores y consumidores de la cinta (más de uno solo en modo MPMC)
+	int consumers;
+	int group; // Grupo de robo de trabajo (atributo "group="; 0: sin grupo)
+	bool ordered; // Sus elementos solo los obtienen sus consumidores (atributo "order=strict")
+	int priority; // Prioridad frente al resto de cintas (atributo "priority="; 0: la más baja)
+	int rate; // Elementos por segundo como máximo de sus productores (atributo "rate="; 0: sin límite)
+	uint64_t run_start_ns; // Arranque y final de sus hilos o de sus turnos en el pool (informe de ritmo)
+	uint64_t run_end_ns;
+	uint64_t not_before_ns; // Pool: turno sin fichas, no vuelve a ejecutarse antes de este instante (0: ya)
+	struct s_tape *later; // Pool: siguiente cinta del trabajador que espera fichas
 	pthread_t tape_id;
-	pthread_cond_t not_full;
-	pthread_cond_t not_empty;
-	pthread_mutex_t queue_mtx;
 	t_factory *factory;
 	t_element *elements;
+	t_mpmc_cell *cells; // Modo MPMC: max_size celdas
+	void *buffer; // Memoria de la cola en la arena: elements o cells según el modo
+	pthread_t *threads; // Productores seguidos de consumidores (en la arena)
+	t_element *batches; // Lotes locales de sus hilos, uno tras otro (en la arena)
+	atomic_int batch_slot; // Siguiente lote de batches sin hilo asignado
+	cpu_set_t cpus; // CPU de los hilos de la cinta (vacío: sin fijar)
+	bool pinned; // cpus viene del atributo "cpus=" y no de la política de la fábrica
+	const t_stage *stage; // Procesamiento de los consumidores (NULL: ninguno)
+	struct s_tape *upstream; // Cinta cuyos consumidores producen en esta (NULL: la cinta genera sus elementos)
+	struct s_tape *next; // Cinta a la que los consumidores pasan los elementos procesados
+
+	// Sincronización compartida del modo mutex
+	_Alignas(CACHE_LINE) pthread_mutex_t queue_mtx;
+	pthread_cond_t not_full;
+	pthread_cond_t not_empty;
+	int size; //size
+	bool finished;
+	int adapt_ops; // Cinta adaptable: lotes del productor en la ventana actual
+	int adapt_full; // Lotes de la ventana en los que el productor esperó con la cinta llena
+	int adapt_empty; // Esperas del consumidor por elementos en la ventana
+	int resizes; // Cambios de capacidad de la ejecución
+	atomic_int feeders; // Cinta de un pipeline: consumidores de la cinta anterior que aún le pasan elementos
+	atomic_int thieves; // Consumidores de otras cintas del grupo con un lote robado aún sin registrar
+
+	// Lado productor
+	_Alignas(CACHE_LINE) int tail;
+	int num_created;
+	int ckpt_base; // Ediciones obtenidas antes de la primera posición del anillo (al reanudar, si no 0)
+	int reserved; // Modo mutex: posiciones reservadas con queue_reserve sin confirmar
+	_Atomic uint64_t rate_tat; // Cinta limitada: instante en que el cubo de fichas vuelve a estar lleno (ns)
+	atomic_uint ring_tail; // Modo SPSC: siguiente posición a escribir
+	unsigned head_cache; // Modo SPSC: última copia de ring_head vista por el productor
+	unsigned prod_spin; // Modo SPSC: vueltas de espera activa adaptativas del productor
+	atomic_uint cons_waiting; // Modo SPSC: el consumidor duerme en el futex de ring_tail
+	atomic_uint enq_pos; // Modo MPMC: siguiente posición a escribir
+	atomic_uint next_edition; // Modo MPMC: siguiente número de edición a repartir entre productores
+	atomic_uint put_epoch; // Modo MPMC: futex de los consumidores, avanza al publicar si duermen
+	atomic_uint cons_sleepers; // Modo MPMC: consumidores dormidos o a punto de dormir
+#ifdef FACTORY_STATS
+	t_wait_stats full_wait; // Esperas del productor con la cinta llena
+	uint64_t start_ns; // Creación de la cinta
+#endif
+
+	// Lado consumidor
+	_Alignas(CACHE_LINE) int head;
+	int peeked; // Modo mutex: elementos devueltos por queue_peek sin liberar
+	atomic_uint ring_head; // Modo SPSC: siguiente posición a leer
+	unsigned tail_cache; // Modo SPSC: última copia de ring_tail vista por el consumidor
+	unsigned cons_spin; // Modo SPSC: vueltas de espera activa adaptativas del consumidor
+	atomic_uint prod_waiting; // Modo SPSC: el productor duerme en el futex de ring_head
+	atomic_uint deq_pos; // Modo MPMC: siguiente posición a leer
+	atomic_uint get_epoch; // Modo MPMC: futex de los productores, avanza al liberar celdas si duermen
+	atomic_uint prod_sleepers; // Modo MPMC: productores dormidos o a punto de dormir
+#ifdef FACTORY_STATS
+	t_wait_stats empty_wait; // Esperas del consumidor hasta tener elementos que obtener
+	uint64_t lat_hist[STATS_BUCKETS]; // Histograma del tiempo en cola: cubeta i = [2^(i-1), 2^i) ns
+	uint64_t *lat_samples; // Latencias put->get muestreadas por el consumidor (ns, en la arena)
+	int lat_count;
+	int lat_stride; // Se muestrea uno de cada lat_stride elementos
+	uint64_t occ_sum; // Suma de las ocupaciones observadas en cada obtención
+	uint64_t occ_samples;
+	int occ_max;
+	uint64_t end_ns; // Obtención del último elemento
+#endif
 } t_tape;
 
+// Hilo que ejecuta en línea, una tras otra, un grupo de cintas pequeñas (modo con hilos)
+typedef struct s_inline_run
+{
+	t_tape **tapes;
+	int n_tapes;
+	int barrier_id; // Participante de la barrera de arranque: uno por hilo, no por cinta
+	pthread_t thread;
+} t_inline_run;
+
 typedef struct s_factory
 {
 	int max_tapes;
 	int n_tapes;
-	int ready_tapes;
-	int waiting_tapes;
-	pthread_cond_t ready_threads;
-	pthread_cond_t waiting_threads;
-	pthread_cond_t broadcast;
-	sem_t sem;
-	pthread_mutex_t mtx;
+	int batch_size; // Elementos que mueven productor y consumidor por cada acceso a la cinta
+	t_pool *pool; // Pool de hilos que ejecuta las cintas (NULL: tres hilos por cinta)
+	t_affinity affinity; // Colocación de las cintas sin lista de CPU propia
+#ifdef FACTORY_STATS
+	FILE *stats_out; // Destino del informe de estadísticas al terminar run_factory (NULL: no se escribe)
+#endif
+	t_barrier barrier; // Arranque: las cintas (ids 0..n_tapes-1) y la fábrica (id n_tapes)
+	t_arena arena; // Memoria de la ejecución, se reparte al empezar run_factory y se libera en free_all
+	t_checkpoint checkpoint; // Puntos de control de la ejecución (opciones -c y -r)
+	t_metrics metrics; // Métricas de la ejecución en marcha (opción -m)
+	int fork_group; // Modo multiproceso: cintas por proceso (0: todas las cintas en este proceso)
+	int priority_top; // Prioridad más alta de las cintas (la calcula factory_priority en run_factory)
 	t_tape *tapes;
 } t_factory;
 
+// Primer error encontrado al analizar el fichero de entrada
+typedef struct s_parse_error
+{
+	int line;
+	int column;
+	const char *msg;
+} t_parse_error;
+
+#ifdef FACTORY_STATS
+// Resumen de la instrumentación de una cinta (factory_stats)
+typedef struct s_belt_stats
+{
+	int id;
+	int capacity; // Al terminar (una cinta adaptable puede acabar con otra distinta de la inicial)
+	int capacity_min; // Límites de "resize=" (iguales a capacity si la cinta no se adapta)
+	int capacity_max;
+	int resizes; // Cambios de capacidad
+	int elements; // Elementos obtenidos
+	double elements_per_sec; // Desde la creación de la cinta hasta obtener el último elemento
+	uint64_t p50_ns; // Percentiles de la latencia put->get
+	uint64_t p99_ns;
+	uint64_t lat_hist[STATS_BUCKETS];
+	t_wait_stats full_wait;
+	t_wait_stats empty_wait;
+	double occupancy_avg;
+	int occupancy_max;
+} t_belt_stats;
+#endif
+
 typedef enum e_operations
 {
 	CREATE,
@@ -84,25 +436,175 @@ typedef enum e_operations
 } t_operations;
 
 
+// Niveles de detalle del registro (opción -v)
+typedef enum e_log_level
+{
+	LOG_QUIET, // Ningún mensaje [OK]
+	LOG_INFO, // Solo mensajes del ciclo de vida de cintas y fábrica
+	LOG_ELEMENTS, // Además, cada elemento introducido y obtenido (salida original)
+} t_log_level;
+
+// Mensajes que puede emitir la fábrica; el texto de cada uno está en log.c
+typedef enum e_log_msg
+{
+	LOG_TAPE_CREATED,
+	LOG_TAPE_WAITING,
+	LOG_BELT_CREATED,
+	LOG_INTRODUCED,
+	LOG_OBTAINED,
+	LOG_TAPE_PRODUCED,
+	LOG_TAPE_FINISHED,
+	LOG_FINISHING,
+} t_log_msg;
+
+// PARSER
+t_factory *parser(const char *filename);
+t_factory *parse_buffer(const char *data, size_t len, t_parse_error *err);
+t_factory *factory_create(int max_tapes);
+
+// FACTORY MANAGER
+void run_factory(t_factory *factory);
+void tape_init(t_tape *tape);
+void tape_release(t_tape *tape);
+
+// CHECKPOINT
+void checkpoint_open(t_factory *factory, const char *path, bool resume);
+void checkpoint_restore(t_tape *queue);
+void checkpoint_start(t_factory *factory);
+void checkpoint_stop(t_factory *factory);
+void checkpoint_close(t_checkpoint *ckpt);
+
+// METRICS
+void metrics_open(t_factory *factory, const char *path, int interval_ms);
+void metrics_start(t_factory *factory);
+void metrics_stop(t_factory *factory);
+void metrics_close(t_metrics *metrics);
+
+// FORK
+void factory_share(t_factory *factory, int group);
+void run_factory_fork(t_factory *factory);
+void sync_shared(void);
+
+// DAEMON
+void daemon_signals(void);
+int factory_daemon(t_factory *warm, const char *path);
+
 // PROCESS MANAGER
 void *process_manager (void *arg);
+int belt_batch(t_tape *queue);
+bool belt_step(t_tape *queue, t_element *items, int quantum);
+bool belt_inline(const t_tape *queue);
+void *inline_runner(void *arg);
+
+// PIPELINE
+int stage_register(const char *name, t_stage_fn fn, void *arg);
+const t_stage *stage_find(const char *name, size_t len);
+
+// THREAD POOL
+t_pool *pool_create(int n_workers);
+void pool_run(t_pool *pool, t_factory *factory);
+void pool_destroy(t_pool *pool);
+
+// BARRIER
+size_t barrier_size(int participants);
+void barrier_init(t_barrier *barrier, int participants, void *nodes);
+void barrier_wait(t_barrier *barrier, int id);
+
+// ARENA
+void *arena_alloc(t_arena *arena, size_t size, size_t align);
+void arena_destroy(t_arena *arena);
+void factory_arena(t_factory *factory);
+
+// AFFINITY
+void factory_affinity(t_factory *factory);
+void affinity_thread(t_tape *queue, int slot);
+void affinity_touch(t_tape *queue);
 
 // QUEUE OPERATIONS
+size_t queue_buffer_size(const t_tape *queue, int capacity);
 int queue_init(t_tape *queue, int capacity);
+int queue_resize(t_tape *queue, int capacity);
+void queue_ring(t_tape *queue);
 int queue_destroy(t_tape *queue);
 int queue_put(t_tape *queue, t_element *x);
 t_element *queue_get(t_tape *queue);
 int queue_empty(t_tape *queue);
 int queue_full(t_tape *queue);
+int queue_put_batch(t_tape *queue, t_element *items, int n);
+int queue_get_batch(t_tape *queue, t_element *items, int max);
+t_element *queue_reserve(t_tape *queue, int *n);
+int queue_commit(t_tape *queue, int n);
+t_element *queue_peek(t_tape *queue, int *n);
+void queue_release(t_tape *queue, int n);
+int queue_spsc_put(t_tape *queue, t_element *x);
+int queue_spsc_get(t_tape *queue, t_element *x);
+void queue_spsc_wait_put(t_tape *queue);
+int queue_spsc_put_batch(t_tape *queue, t_element *items, int n);
+int queue_spsc_get_batch(t_tape *queue, t_element *items, int max);
+t_element *queue_spsc_reserve(t_tape *queue, int *n);
+int queue_spsc_commit(t_tape *queue, int n);
+t_element *queue_spsc_peek(t_tape *queue, int *n);
+void queue_spsc_release(t_tape *queue, int n);
+int queue_mpmc_claim(t_tape *queue, t_element *items, int n);
+int queue_mpmc_put_batch(t_tape *queue, t_element *items, int n);
+void queue_mpmc_wait_put(t_tape *queue);
+int queue_mpmc_get_batch(t_tape *queue, t_element *items, int max);
+
+// RATE
+int rate_take(t_tape *queue, int n, bool wait);
+uint64_t rate_ready(const t_tape *queue);
+void factory_priority(t_factory *factory);
+void priority_thread(t_tape *queue);
+void factory_rates(t_factory *factory, FILE *out);
+
+// SINK
+int sink_init(const char *path, bool per_belt);
+void sink_elements(const t_element *items, int n);
+void sink_flush(void);
+void sink_fork_prepare(void);
+void sink_fork_done(bool child);
+void sink_shutdown(void);
+
+// LOG
+void log_init(int level, int sample);
+void log_shutdown(void);
+void log_msg(t_log_msg msg, int a, int b);
+void log_elements(t_log_msg msg, const t_element *items, int n, uint64_t ts);
+uint64_t log_stamp(void);
+uint64_t log_clock(void);
+void log_fork_prepare(void);
+void log_fork_done(bool child);
+
+// STATS (solo con -DFACTORY_STATS; si no, las llamadas desaparecen)
+#ifdef FACTORY_STATS
+void stats_init(t_tape *queue);
+void stats_obtained(t_tape *queue, const t_element *items, int n, int occupancy);
+void stats_waited(t_wait_stats *wait, uint64_t start);
+size_t stats_size(const t_tape *queue);
+int factory_stats(t_factory *factory, int index, t_belt_stats *out);
+void factory_stats_dump(t_factory *factory, FILE *out);
+# define stats_clock() log_clock()
+# define STATS_WAITED(queue, field, start) stats_waited(&(queue)->field, start)
+#else
+# define stats_init(queue) ((void)0)
+# define stats_obtained(queue, items, n, occupancy) ((void)0)
+# define stats_size(queue) ((size_t)0)
+# define stats_clock() 0
+# define STATS_WAITED(queue, field, start) ((void)(start))
+#endif
 
 // UTILS
 void *safe_malloc(size_t size, bool calloc_flag);
+void *safe_aligned_malloc(size_t size);
 void safe_sem(sem_t *sem, int value, t_operations operation);
 void safe_thread(pthread_t *thread, void *(*f)(void *), void *arg, void **retval, t_operations operation);
 void safe_mutex(pthread_mutex_t *mutex, t_operations operation);
 void safe_cond(pthread_cond_t *cond, pthread_mutex_t *mutex, t_operations operation);
 void safe_close(FILE *fd);
 void free_all(t_factory *factory);
-void err_free_exit(t_factory *factory, const char *msg);
+void err_free_exit(t_factory *factory, const char *msg) __attribute__((noreturn));
+void futex_wait(atomic_uint *addr, unsigned value);
+void futex_timedwait(atomic_uint *addr, unsigned value, uint64_t ns);
+void futex_wake(atomic_uint *addr, int count);
 
 #endif
@@ -0,0 +1,127 @@
+#include "queue.h"
+#include <errno.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+// Prioridades y límites de ritmo de las cintas (atributos "priority=" y "rate="). El límite es un cubo
+// de fichas en su forma de tiempo teórico de llegada (rate_tat): cada elemento cuesta 1e9 / rate ns y
+// un lote se admite cuando rate_tat, tras sumarle su coste, no adelanta al reloj en más de la ráfaga
+// del cubo. Al ser un único contador que se avanza con CAS, lo comparten los productores de una cinta
+// MPMC. La prioridad se aplica con el valor nice de los hilos de la cinta (solo se puede bajar sin
+// privilegios: las cintas de menor prioridad ceden la CPU) y, en el pool, con turnos más largos.
+
+// Ráfaga del cubo de una cinta: RATE_BURST_NS o, si es menos, lo que cuesta un elemento
+static inline uint64_t rate_burst(const t_tape *queue)
+{
+    uint64_t cost;
+
+    cost = 1000000000ull / queue->rate;
+    return (cost > RATE_BURST_NS ? cost : RATE_BURST_NS);
+}
+
+// Toma fichas para n elementos de una cinta limitada. Con wait espera a tenerlas todas; si no, toma
+// las que ya hay (puede ser ninguna). Devuelve los elementos que se pueden producir
+int rate_take(t_tape *queue, int n, bool wait)
+{
+    struct timespec until;
+    uint64_t burst;
+    uint64_t now;
+    uint64_t tat;
+    uint64_t base;
+    uint64_t next;
+    uint64_t avail;
+
+    if (!queue->rate || n <= 0)
+        return (n);
+    burst = rate_burst(queue);
+    now = log_clock();
+    tat = atomic_load_explicit(&queue->rate_tat, memory_order_relaxed);
+    do
+    {
+        base = tat > now ? tat : now; // Un cubo lleno no acumula más fichas que la ráfaga
+        if (!wait)
+        {
+            avail = now + burst > base ? (now + burst - base) * queue->rate / 1000000000ull : 0;
+            if (avail < (uint64_t)n)
+                n = (int)avail;
+            if (!n)
+                return (0);
+        }
+        next = base + (uint64_t)n * 1000000000ull / queue->rate;
+    } while (!atomic_compare_exchange_weak_explicit(&queue->rate_tat, &tat, next,
+            memory_order_relaxed, memory_order_relaxed));
+    if (next > now + burst) // Las fichas llegan cuando el cubo vuelve a tener sitio para el lote
+    {
+        until.tv_sec = (next - burst) / 1000000000ull;
+        until.tv_nsec = (next - burst) % 1000000000ull;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR)
+            ;
+    }
+    return (n);
+}
+
+// Instante en que una cinta limitada vuelve a tener una ficha, o 0 si ya la tiene (o no está limitada).
+// Con él, el pool aparta el turno de una cinta sin fichas en lugar de volver a tomarla enseguida
+uint64_t rate_ready(const t_tape *queue)
+{
+    uint64_t burst;
+    uint64_t now;
+    uint64_t tat;
+
+    if (!queue->rate)
+        return (0);
+    burst = rate_burst(queue);
+    now = log_clock();
+    tat = atomic_load_explicit(&queue->rate_tat, memory_order_relaxed) + 1000000000ull / queue->rate;
+    return (tat > now + burst ? tat - burst : 0);
+}
+
+// Calcula una sola vez, al empezar run_factory, la prioridad más alta de las cintas de la fábrica
+void factory_priority(t_factory *factory)
+{
+    int i;
+
+    for (i = 0, factory->priority_top = 0; i < factory->n_tapes; i++)
+        if (factory->tapes[i].priority > factory->priority_top)
+            factory->priority_top = factory->tapes[i].priority;
+}
+
+// Fija el valor nice del hilo que llama según la prioridad de su cinta: las cintas de la prioridad
+// más alta de la fábrica conservan el suyo y el resto lo sube en la diferencia (hasta 19). Es el mejor
+// esfuerzo: si falla, el hilo sigue con el que tenía
+void priority_thread(t_tape *queue)
+{
+    int top;
+
+    top = queue->factory->priority_top;
+    if (!top) // Ninguna cinta con "priority=": todos los hilos conservan su valor
+        return ;
+    if (top > queue->priority)
+        setpriority(PRIO_PROCESS, syscall(SYS_gettid), top - queue->priority);
+}
+
+// Informe del ritmo conseguido por cada cinta, si alguna tiene prioridad o límite de ritmo (así
+// la salida de una fábrica sin estos atributos no cambia)
+void factory_rates(t_factory *factory, FILE *out)
+{
+    t_tape *tape;
+    double secs;
+    bool any;
+    int i;
+
+    for (i = 0, any = false; i < factory->n_tapes; i++)
+        any |= factory->tapes[i].priority || factory->tapes[i].rate;
+    for (i = 0; any && i < factory->n_tapes; i++)
+    {
+        tape = &factory->tapes[i];
+        secs = tape->run_end_ns > tape->run_start_ns ? (tape->run_end_ns - tape->run_start_ns) / 1e9 : 0;
+        fprintf(out, "[RATE] Belt %d (priority %d, ", tape->id, tape->priority);
+        if (tape->rate)
+            fprintf(out, "limit %d elem/s", tape->rate);
+        else
+            fprintf(out, "no limit");
+        fprintf(out, "): %d elements in %.3f s, %.0f elem/s\n", tape->num_created, secs,
+            secs > 0 ? tape->num_created / secs : 0);
+    }
+}
@@ -0,0 +1,303 @@
+#include "queue.h"
+#include <errno.h>
+
+// Salida binaria de los elementos obtenidos (opciones -o y -O). Cada consumidor copia sus registros
+// en un bloque propio de SINK_CHUNK bytes y, al llenarlo, lo encola para un hilo de E/S dedicado que
+// lo escribe de una vez; el consumidor solo toma un mutex para encolar el bloque y obtener otro
+// (reutilizado o nuevo), nunca espera al disco. Si el disco no da abasto, crece la memoria en uso.
+// Con -o todos los bloques van a un mismo fichero; con -O cada cinta tiene su fichero en el
+// directorio, que el hilo de E/S abre la primera vez que la ve. Los ficheros se abren con O_APPEND:
+// cada bloque se escribe entero y seguido, también desde los procesos del modo multiproceso. El
+// formato (cabecera t_sink_header y registros t_sink_record) lo lee sink_reader.
+
+// Bloque de registros de un consumidor
+typedef struct s_sink_chunk
+{
+    struct s_sink_chunk *next;
+    int belt; // Cinta de todos sus registros (con -O) o -1 (fichero único)
+    size_t used; // Bytes de data ocupados
+    char data[SINK_CHUNK];
+} t_sink_chunk;
+
+// Fichero de una cinta (con -O)
+typedef struct s_sink_file
+{
+    struct s_sink_file *next;
+    int belt;
+    int fd;
+} t_sink_file;
+
+static bool g_running = false; // El hilo de E/S está activo
+static bool g_per_belt; // Un fichero por cinta en g_path (directorio)
+static const char *g_path;
+static int g_fd = -1; // Fichero único (sin -O)
+static bool g_stop; // Pide al hilo de E/S que escriba lo pendiente y termine (con g_mtx)
+static pthread_t g_writer;
+static pthread_mutex_t g_mtx = PTHREAD_MUTEX_INITIALIZER; // Protege las listas de bloques
+static pthread_cond_t g_wake = PTHREAD_COND_INITIALIZER; // Hay bloques que escribir o hay que terminar
+static t_sink_chunk *g_pending = NULL; // Bloques por escribir, el último encolado primero
+static t_sink_chunk *g_free = NULL; // Bloques ya escritos, para reutilizar
+static int g_free_count = 0;
+static t_sink_file *g_files = NULL; // Solo los usa el hilo de E/S
+static bool g_failed = false; // Ya se ha informado de un error de escritura
+static __thread t_sink_chunk *tls_chunk = NULL;
+
+// Escribe la cabecera de un fichero nuevo
+static int sink_header(int fd)
+{
+    t_sink_header header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SINK_MAGIC, sizeof(header.magic));
+    header.record_size = sizeof(t_sink_record);
+    return (write(fd, &header, sizeof(header)) == sizeof(header) ? 0 : -1);
+}
+
+// Abre (vacío) un fichero de salida con su cabecera. Devuelve -1 si falla
+static int sink_open(const char *path)
+{
+    int fd;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd != -1 && sink_header(fd) == -1)
+    {
+        close(fd);
+        return (-1);
+    }
+    return (fd);
+}
+
+// Descriptor del fichero de un bloque: el único o, con -O, el de su cinta (abierto la primera vez)
+static int sink_fd(int belt)
+{
+    t_sink_file *file;
+    char path[PATH_MAX];
+
+    if (!g_per_belt)
+        return (g_fd);
+    for (file = g_files; file; file = file->next)
+        if (file->belt == belt)
+            return (file->fd);
+    file = safe_malloc(sizeof(t_sink_file), false);
+    file->belt = belt;
+    file->fd = -1;
+    if (snprintf(path, sizeof(path), "%s/belt_%d.bin", g_path, belt) < (int)sizeof(path))
+        file->fd = sink_open(path);
+    file->next = g_files;
+    g_files = file;
+    return (file->fd);
+}
+
+// Escribe un bloque entero (hilo de E/S). Los errores se informan una vez y el bloque se descarta
+static void sink_write(t_sink_chunk *chunk)
+{
+    ssize_t done;
+    size_t off;
+    int fd;
+
+    fd = sink_fd(chunk->belt);
+    for (off = 0; fd != -1 && off < chunk->used; off += done)
+    {
+        done = write(fd, chunk->data + off, chunk->used - off);
+        if (done == -1 && errno == EINTR)
+            done = 0;
+        else if (done <= 0)
+            fd = -1;
+    }
+    if (fd == -1 && !g_failed)
+    {
+        g_failed = true;
+        fprintf(stderr, "[ERROR][sink] Cannot write the output of belt %d.\n", chunk->belt);
+    }
+}
+
+// Hilo de E/S: toma todos los bloques pendientes de una vez y los escribe en el orden en que se
+// encolaron, sin g_mtx; los devuelve a la lista libre (como mucho SINK_FREE_CHUNKS)
+static void *sink_writer(void *arg)
+{
+    t_sink_chunk *batch;
+    t_sink_chunk *chunk;
+    t_sink_chunk *fifo;
+    bool stop;
+
+    (void)arg;
+    stop = false;
+    while (!stop)
+    {
+        pthread_mutex_lock(&g_mtx);
+        while (!g_pending && !g_stop)
+            pthread_cond_wait(&g_wake, &g_mtx);
+        batch = g_pending;
+        g_pending = NULL;
+        stop = g_stop && !batch;
+        pthread_mutex_unlock(&g_mtx);
+        for (fifo = NULL; (chunk = batch); fifo = chunk) // Invierte la lista: primero el más antiguo
+        {
+            batch = chunk->next;
+            chunk->next = fifo;
+        }
+        for (chunk = fifo; chunk; chunk = fifo)
+        {
+            fifo = chunk->next;
+            sink_write(chunk);
+            pthread_mutex_lock(&g_mtx);
+            if (g_free_count < SINK_FREE_CHUNKS)
+            {
+                chunk->next = g_free;
+                g_free = chunk;
+                g_free_count++;
+                chunk = NULL;
+            }
+            pthread_mutex_unlock(&g_mtx);
+            free(chunk);
+        }
+    }
+    return (NULL);
+}
+
+// Encola el bloque del hilo para el hilo de E/S
+void sink_flush(void)
+{
+    if (!tls_chunk)
+        return ;
+    if (tls_chunk->used)
+    {
+        pthread_mutex_lock(&g_mtx);
+        tls_chunk->next = g_pending;
+        g_pending = tls_chunk;
+        pthread_cond_signal(&g_wake);
+        pthread_mutex_unlock(&g_mtx);
+    }
+    else
+        free(tls_chunk);
+    tls_chunk = NULL;
+}
+
+// Bloque vacío para los registros de la cinta belt: uno ya escrito o, si no queda, uno nuevo
+static t_sink_chunk *sink_chunk(int belt)
+{
+    t_sink_chunk *chunk;
+
+    pthread_mutex_lock(&g_mtx);
+    if ((chunk = g_free))
+    {
+        g_free = chunk->next;
+        g_free_count--;
+    }
+    pthread_mutex_unlock(&g_mtx);
+    if (!chunk)
+        chunk = safe_malloc(sizeof(t_sink_chunk), false);
+    chunk->belt = g_per_belt ? belt : -1;
+    chunk->used = 0;
+    return (chunk);
+}
+
+// Añade los registros de un lote obtenido al bloque del hilo. Con -O un bloque solo guarda
+// registros de una cinta: si el hilo cambia de cinta (pool) se encola el anterior
+void sink_elements(const t_element *items, int n)
+{
+    t_sink_record rec;
+    int i;
+
+    if (!g_running || n <= 0)
+        return ;
+    if (tls_chunk && g_per_belt && tls_chunk->belt != items[0].id_belt)
+        sink_flush();
+    for (i = 0; i < n; i++)
+    {
+        if (tls_chunk && tls_chunk->used + sizeof(t_sink_record) > SINK_CHUNK)
+            sink_flush();
+        if (!tls_chunk)
+            tls_chunk = sink_chunk(items[i].id_belt);
+        rec.num_edition = items[i].num_edition;
+        rec.id_belt = items[i].id_belt;
+        rec.last = items[i].last != 0;
+        memcpy(tls_chunk->data + tls_chunk->used, &rec, sizeof(t_sink_record));
+        tls_chunk->used += sizeof(t_sink_record);
+    }
+}
+
+// Arranca la salida: un fichero único en path o, con per_belt, un fichero por cinta en el
+// directorio path. Devuelve -1 si no se puede crear el fichero o el directorio no existe
+int sink_init(const char *path, bool per_belt)
+{
+    struct stat st;
+
+    if (per_belt && (stat(path, &st) == -1 || !S_ISDIR(st.st_mode)))
+        return (-1);
+    if (!per_belt && (g_fd = sink_open(path)) == -1)
+        return (-1);
+    g_path = path;
+    g_per_belt = per_belt;
+    g_stop = false;
+    if (pthread_create(&g_writer, NULL, sink_writer, NULL))
+        err_free_exit(NULL, "[ERROR][sink] Output initialization failed.");
+    g_running = true;
+    return (0);
+}
+
+// Antes de fork: ningún bloque a medias de encolar al duplicarse el proceso
+void sink_fork_prepare(void)
+{
+    if (g_running)
+        pthread_mutex_lock(&g_mtx);
+}
+
+// Después de fork. En el hijo no existe el hilo de E/S y los bloques pendientes heredados los escribe
+// el padre: el hijo empieza sin pendientes, con su propio hilo y sus propios ficheros por cinta. El
+// mutex y la condición se crean de nuevo: la condición aún cuenta al hilo de E/S del padre como en espera
+void sink_fork_done(bool child)
+{
+    t_sink_file *file;
+
+    if (!g_running)
+        return ;
+    if (!child)
+    {
+        pthread_mutex_unlock(&g_mtx);
+        return ;
+    }
+    g_pending = NULL;
+    while ((file = g_files)) // Solo los tiene el hilo de E/S del padre, que sigue escribiendo en ellos
+    {
+        g_files = file->next;
+        free(file);
+    }
+    pthread_mutex_init(&g_mtx, NULL);
+    pthread_cond_init(&g_wake, NULL);
+    if (pthread_create(&g_writer, NULL, sink_writer, NULL))
+        err_free_exit(NULL, "[ERROR][sink] Output initialization failed.");
+}
+
+// Encola el bloque del hilo que llama, escribe todo lo pendiente y cierra los ficheros
+void sink_shutdown(void)
+{
+    t_sink_chunk *chunk;
+    t_sink_file *file;
+
+    if (!g_running)
+        return ;
+    sink_flush();
+    pthread_mutex_lock(&g_mtx);
+    g_stop = true;
+    pthread_cond_signal(&g_wake);
+    pthread_mutex_unlock(&g_mtx);
+    pthread_join(g_writer, NULL);
+    g_running = false;
+    while ((chunk = g_free))
+    {
+        g_free = chunk->next;
+        free(chunk);
+    }
+    g_free_count = 0;
+    while ((file = g_files))
+    {
+        g_files = file->next;
+        if (file->fd != -1)
+            close(file->fd);
+        free(file);
+    }
+    if (g_fd != -1)
+        close(g_fd);
+    g_fd = -1;
+}
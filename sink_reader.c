@@ -0,0 +1,144 @@
+#include "queue.h"
+
+// Lector de los ficheros de salida de la fábrica (opciones -o y -O). Es un programa independiente
+// (make sink_reader). Uso: ./sink_reader [-s] fichero...
+// Sin -s escribe un registro por línea: cinta, edición y marca de último, separados por tabuladores.
+// Con -s escribe por cada cinta cuántos registros tiene, cuántas ediciones de 0 a la mayor faltan o
+// están repetidas y si apareció el elemento marcado como último.
+
+#define READER_RECORDS 65536 // Registros que se leen de una vez
+
+// Resumen de una cinta (-s)
+typedef struct s_reader_belt
+{
+    int id;
+    long records;
+    bool last; // Apareció el elemento marcado como último
+    int *seen; // Veces que aparece cada edición
+    int n_seen;
+} t_reader_belt;
+
+static t_reader_belt *g_belts = NULL;
+static int g_n_belts = 0;
+
+// Resumen de la cinta id (lo crea la primera vez)
+static t_reader_belt *reader_belt(int id)
+{
+    t_reader_belt *belt;
+    int i;
+
+    for (i = 0; i < g_n_belts; i++)
+        if (g_belts[i].id == id)
+            return (&g_belts[i]);
+    if (!(belt = realloc(g_belts, (g_n_belts + 1) * sizeof(t_reader_belt))))
+        exit((fprintf(stderr, "[ERROR][sink_reader] Memory allocation failed.\n"), -1));
+    g_belts = belt;
+    belt = &g_belts[g_n_belts++];
+    memset(belt, 0, sizeof(t_reader_belt));
+    belt->id = id;
+    return (belt);
+}
+
+// Cuenta un registro en el resumen de su cinta
+static void reader_count(const t_sink_record *rec)
+{
+    t_reader_belt *belt;
+    int *seen;
+    int n;
+
+    belt = reader_belt(rec->id_belt);
+    belt->records++;
+    belt->last |= rec->last;
+    if (rec->num_edition < 0)
+        return ;
+    if (rec->num_edition >= belt->n_seen) // Crece al doble de la edición mayor vista
+    {
+        n = rec->num_edition < INT_MAX / 2 ? rec->num_edition * 2 + 1 : INT_MAX;
+        if (!(seen = realloc(belt->seen, n * sizeof(int))))
+            exit((fprintf(stderr, "[ERROR][sink_reader] Memory allocation failed.\n"), -1));
+        memset(seen + belt->n_seen, 0, (n - belt->n_seen) * sizeof(int));
+        belt->seen = seen;
+        belt->n_seen = n;
+    }
+    belt->seen[rec->num_edition]++;
+}
+
+// Lee un fichero. Devuelve -1 si no existe o no es un fichero de salida de la fábrica
+static int reader_file(const char *path, bool summary)
+{
+    t_sink_header header;
+    t_sink_record *records;
+    size_t got;
+    size_t i;
+    FILE *in;
+
+    if (!(in = fopen(path, "rb")))
+        return (-1);
+    if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, SINK_MAGIC, sizeof(header.magic))
+        || header.record_size != sizeof(t_sink_record))
+    {
+        fclose(in);
+        return (-1);
+    }
+    records = malloc(READER_RECORDS * sizeof(t_sink_record));
+    while (records && (got = fread(records, sizeof(t_sink_record), READER_RECORDS, in)) > 0)
+    {
+        for (i = 0; i < got; i++)
+        {
+            if (summary)
+                reader_count(&records[i]);
+            else
+                printf("%d\t%d\t%d\n", records[i].id_belt, records[i].num_edition, records[i].last);
+        }
+    }
+    free(records);
+    fclose(in);
+    return (0);
+}
+
+// Escribe el resumen de cada cinta en el orden en que aparecieron
+static void reader_summary(void)
+{
+    t_reader_belt *belt;
+    int missing;
+    int repeated;
+    int top;
+    int i;
+    int e;
+
+    for (i = 0; i < g_n_belts; i++)
+    {
+        belt = &g_belts[i];
+        for (top = belt->n_seen - 1; top >= 0 && !belt->seen[top]; top--)
+            ;
+        missing = 0;
+        repeated = 0;
+        for (e = 0; e <= top; e++)
+        {
+            missing += !belt->seen[e];
+            repeated += belt->seen[e] > 1 ? belt->seen[e] - 1 : 0;
+        }
+        printf("Belt %d: %ld records, editions 0-%d, %d missing, %d repeated, last %s\n", belt->id,
+            belt->records, top, missing, repeated, belt->last ? "seen" : "not seen");
+        free(belt->seen);
+    }
+    free(g_belts);
+}
+
+int main(int argc, char **argv)
+{
+    bool summary;
+    int i;
+
+    summary = (argc > 1 && !strcmp(argv[1], "-s"));
+    if (argc - summary < 2)
+        return (fprintf(stderr, "[ERROR][sink_reader] Usage: %s [-s] file...\n", argv[0]), -1);
+    for (i = 1 + summary; i < argc; i++)
+    {
+        if (reader_file(argv[i], summary) == -1)
+            return (fprintf(stderr, "[ERROR][sink_reader] %s is not a factory output file.\n", argv[i]), -1);
+    }
+    if (summary)
+        reader_summary();
+    return (0);
+}
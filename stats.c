@@ -0,0 +1,150 @@
+#include "queue.h"
+
+// Instrumentación opcional de las cintas, compilada solo con -DFACTORY_STATS (make stats, make bench).
+// Cada elemento lleva el instante en que entró en la cinta; el consumidor clasifica su tiempo en cola
+// en un histograma log2 y guarda una muestra de uno de cada lat_stride elementos para los percentiles.
+// Además se cuentan las esperas por cinta llena y por falta de elementos y la ocupación en cada
+// obtención. Sin el flag, las llamadas son macros vacías y t_tape no crece. En las cintas MPMC con
+// varios consumidores el registro de obtenciones se serializa con queue_mtx, que ese modo no usa.
+
+#ifdef FACTORY_STATS
+
+// Bytes de las muestras de latencia de una cinta, que reserva la arena de la fábrica (así también
+// las ve el proceso principal en el modo multiproceso)
+size_t stats_size(const t_tape *queue)
+{
+    int stride;
+
+    stride = (queue->num_elements + STATS_SAMPLES - 1) / STATS_SAMPLES;
+    return (stride > 0 ? (size_t)((queue->num_elements + stride - 1) / stride) * sizeof(uint64_t) : 0);
+}
+
+// Reinicia la instrumentación de la cinta y reparte sus muestras de latencia entre sus elementos
+void stats_init(t_tape *queue)
+{
+    queue->lat_stride = (queue->num_elements + STATS_SAMPLES - 1) / STATS_SAMPLES;
+    queue->lat_count = 0;
+    memset(queue->lat_hist, 0, sizeof(queue->lat_hist));
+    memset(&queue->full_wait, 0, sizeof(t_wait_stats));
+    memset(&queue->empty_wait, 0, sizeof(t_wait_stats));
+    queue->occ_sum = 0;
+    queue->occ_samples = 0;
+    queue->occ_max = 0;
+    queue->start_ns = log_clock();
+    queue->end_ns = queue->start_ns;
+}
+
+// Cubeta del histograma de un tiempo en cola: la i contiene [2^(i-1), 2^i) ns
+static inline int stats_bucket(uint64_t ns)
+{
+    int bucket;
+
+    bucket = ns ? 64 - __builtin_clzll(ns) : 0;
+    return (bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1);
+}
+
+// Registra los n elementos obtenidos y la ocupación de la cinta antes de obtenerlos
+void stats_obtained(t_tape *queue, const t_element *items, int n, int occupancy)
+{
+    uint64_t now;
+    int i;
+
+    if (!queue->lat_samples)
+        return ;
+    if (queue->consumers > 1)
+        safe_mutex(&queue->queue_mtx, LOCK);
+    now = log_clock();
+    for (i = 0; i < n; i++)
+    {
+        queue->lat_hist[stats_bucket(now - items[i].ts)]++;
+        if (items[i].num_edition % queue->lat_stride == 0)
+            queue->lat_samples[queue->lat_count++] = now - items[i].ts;
+    }
+    if (occupancy > queue->max_size) // En modo MPMC es una estimación que puede contar celdas reservadas
+        occupancy = queue->max_size;
+    queue->occ_sum += occupancy;
+    queue->occ_samples++;
+    if (occupancy > queue->occ_max)
+        queue->occ_max = occupancy;
+    queue->end_ns = now;
+    if (queue->consumers > 1)
+        safe_mutex(&queue->queue_mtx, UNLOCK);
+}
+
+// Suma una espera que empezó en start (solo se llama si de verdad hubo que esperar). Atómica:
+// en modo MPMC varios productores o consumidores comparten los contadores de su lado
+void stats_waited(t_wait_stats *wait, uint64_t start)
+{
+    __atomic_fetch_add(&wait->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&wait->ns, log_clock() - start, __ATOMIC_RELAXED);
+}
+
+static int compare_u64(const void *x, const void *y)
+{
+    uint64_t a = *(const uint64_t *)x;
+    uint64_t b = *(const uint64_t *)y;
+
+    return ((a > b) - (a < b));
+}
+
+// Resume la instrumentación de la cinta index. Devuelve -1 si no existe
+// Se debe llamar con la cinta ya terminada (después de run_factory)
+int factory_stats(t_factory *factory, int index, t_belt_stats *out)
+{
+    t_tape *queue;
+    uint64_t elapsed;
+
+    if (index < 0 || index >= factory->n_tapes)
+        return (-1);
+    queue = &factory->tapes[index];
+    memset(out, 0, sizeof(t_belt_stats));
+    out->id = queue->id;
+    out->capacity = queue->max_size;
+    out->capacity_min = queue->size_min;
+    out->capacity_max = queue->size_max;
+    out->resizes = queue->resizes;
+    out->elements = queue->num_created;
+    elapsed = queue->end_ns - queue->start_ns;
+    out->elements_per_sec = elapsed ? out->elements / (elapsed / 1e9) : 0.0;
+    if (queue->lat_count)
+    {
+        qsort(queue->lat_samples, queue->lat_count, sizeof(uint64_t), compare_u64);
+        out->p50_ns = queue->lat_samples[(queue->lat_count - 1) * 50 / 100];
+        out->p99_ns = queue->lat_samples[(queue->lat_count - 1) * 99 / 100];
+    }
+    memcpy(out->lat_hist, queue->lat_hist, sizeof(out->lat_hist));
+    out->full_wait = queue->full_wait;
+    out->empty_wait = queue->empty_wait;
+    out->occupancy_avg = queue->occ_samples ? (double)queue->occ_sum / queue->occ_samples : 0.0;
+    out->occupancy_max = queue->occ_max;
+    return (0);
+}
+
+// Escribe el informe de todas las cintas: rendimiento, latencia, esperas, ocupación y el lado que
+// limita la cinta (si el productor espera más con la cinta llena, el cuello de botella es el consumidor)
+void factory_stats_dump(t_factory *factory, FILE *out)
+{
+    t_belt_stats st;
+    int i;
+    int b;
+
+    for (i = 0; factory_stats(factory, i, &st) == 0; i++)
+    {
+        fprintf(out, "[STATS] Belt %d (capacity %d): %d elements, %.0f elem/s, time in queue p50 %.1f us p99 %.1f us\n",
+            st.id, st.capacity, st.elements, st.elements_per_sec, st.p50_ns / 1e3, st.p99_ns / 1e3);
+        fprintf(out, "[STATS] Belt %d: producer waited %lu times (%.3f ms) on a full belt, consumer waited %lu times (%.3f ms) for elements\n",
+            st.id, (unsigned long)st.full_wait.count, st.full_wait.ns / 1e6,
+            (unsigned long)st.empty_wait.count, st.empty_wait.ns / 1e6);
+        fprintf(out, "[STATS] Belt %d: occupancy avg %.1f max %d of %d, %s-bound\n", st.id, st.occupancy_avg,
+            st.occupancy_max, st.capacity, st.full_wait.ns > st.empty_wait.ns ? "consumer" : "producer");
+        if (st.capacity_min < st.capacity_max)
+            fprintf(out, "[STATS] Belt %d: resized %d times within %d-%d, final capacity %d\n", st.id,
+                st.resizes, st.capacity_min, st.capacity_max, st.capacity);
+        for (b = 0; b < STATS_BUCKETS; b++)
+            if (st.lat_hist[b])
+                fprintf(out, "[STATS] Belt %d: time in queue < %llu ns: %lu\n", st.id, 1ull << b,
+                    (unsigned long)st.lat_hist[b]);
+    }
+}
+
+#endif